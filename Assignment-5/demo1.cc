@@ -34,10 +34,12 @@ void randArrChar(Ptr x, Ptr y) {
     cout << "creating random array" << endl;
     ArrPtr arr = createArr(x.type, 50000);
     cout << "array created" << endl;
+    char* vals = new char[50000];
     for (int i = 0; i < 50000; i++) {
-        char val = 'a' + rand() % 26;
-        assignArr(arr, i, val);
+        vals[i] = 'a' + rand() % 26;
     }
+    assignArr(arr, vals, 50000);
+    delete[] vals;
     endScope();
     gcActivate();
 }
@@ -47,10 +49,12 @@ void randArrBool(Ptr x, Ptr y) {
     cout << "creating random array" << endl;
     ArrPtr arr = createArr(x.type, 50000);
     cout << "array created" << endl;
+    bool* vals = new bool[50000];
     for (int i = 0; i < 50000; i++) {
-        bool val = rand() % 2;
-        assignArr(arr, i, val);
+        vals[i] = rand() % 2;
     }
+    assignArr(arr, vals, 50000);
+    delete[] vals;
     endScope();
     gcActivate();
 }
@@ -85,8 +89,7 @@ void test() {
     randArrMediumInt(c, d);
     usleep(10);
     endScope();
-    gcActivate();
-    usleep(10);
+    gcActivate(true);  // wait for the collection
 }
 
 int main() {
@@ -14,19 +14,18 @@ int fibonacciProduct(Ptr k) {
         } else if (i == 1) {
             assignArr(arr, i, 1);
         } else {
-            int a;
-            getVar(arr, i - 1, &a);
-            int b;
-            getVar(arr, i - 2, &b);
-            assignArr(arr, i, a + b);
+            int ab[2];
+            getArr(arr, i - 2, 2, ab);
+            assignArr(arr, i, ab[0] + ab[1]);
         }
     }
     int prod = 1;
+    int* fib = new int[val];
+    getArr(arr, 0, val, fib);
     for (int i = 0; i < val; i++) {
-        int a;
-        getVar(arr, i, &a);
-        prod *= a;
+        prod *= fib[i];
     }
+    delete[] fib;
     endScope();
     gcActivate();
     return prod;
@@ -44,7 +43,7 @@ int main() {
         prod *= arrt[i];
     }
     cout << "Actual Product: " << prod << endl;
-    createMem(250 * 1024 * 1024, true);  // 250MB
+    createMem(250 * 1024 * 1024, true, true);  // 250MB, generational
     // sleep(1);
     initScope();
     Ptr x = createVar(Type::INT);
@@ -53,8 +52,7 @@ int main() {
     cout << "Final Product: " << val << endl;
     endScope();
     // usleep(200 * 1000);
-    gcActivate();
-    usleep(10);
+    gcActivate(true);  // wait for the collection
     // sleep(1);
     freeMem();
 }
\ No newline at end of file
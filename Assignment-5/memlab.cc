@@ -1,10 +1,16 @@
 #include "memlab.h"
 
 #include <pthread.h>
-#include <signal.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <climits>
 #include <cstdio>
 #include <cstring>
 #include <exception>
@@ -14,15 +20,51 @@
 
 #include "debug.h"
 #include "medium_int.h"
+#include "simd.h"
 using namespace std;
 
 bool gc_active = false;
 pthread_t gcThread;
-sem_t sem_gc;
+GcScheduler* gcSched = nullptr;  // only with a garbage collector thread
+GcPacer pacer;
 
 MemBlock* mem = nullptr;
-Stack* stack = nullptr;
 SymbolTable* symTable = nullptr;
+Nursery* nursery = nullptr;  // only in generational mode
+
+int promote(int* p, int sym);
+void initMem(int heapBytes, int nurseryWords, int maxBytes, int symtable_size, PageMode pages);
+void startCollector(bool gc, int compactThreads);
+void* compactWorker(void* arg);
+bool gcHasWork();
+void gcNotify();
+void pacerAlloc(int words);
+void sweepQueued();
+void _freeElem(int local_addr);
+
+ThreadCache* caches = nullptr;  // all registered thread caches
+pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t cacheKey;
+pthread_once_t cacheKeyOnce = PTHREAD_ONCE_INIT;
+thread_local ThreadCache* tcache = nullptr;
+int tlabWords = 0;  // size of a thread allocation buffer, 0 if disabled
+unsigned int compactEpoch = 0;  // odd while compaction is moving objects
+int pendingGarbage = 0;         // symbols queued for the next sweep
+int compactPending = 0;         // set by freeElem, the next gc_run checks fragmentation
+vector<pair<int, int>> compactQueue;  // (word offset, symbol) of the blocks of an incremental compaction
+size_t compactNext = 0;               // next entry of compactQueue
+int compactActive = 0;                // set while an incremental compaction cycle is in progress
+int compactStepUs = COMPACT_STEP_US;
+int compactStepBytes = COMPACT_STEP_BYTES;
+CompactPool* compactPool = nullptr;  // only with more than one compaction thread
+vector<CompactRegion> regions;       // regions of the running full compaction
+vector<int> compactPinned;           // sorted offsets of the pinned blocks
+int compactCursor = 0;               // next region or symbol chunk of a compaction task
+vector<int> orphanGarbage;      // garbage queued by threads that exited, guarded by cacheMutex
+int symReserve = 1;
+SlabClass slabClasses[SLAB_CLASSES];  // slabs of scalar variables, indexed by Type
+bool slabs = false;                   // scalars are allocated from slabs
+pthread_mutex_t slabMutex = PTHREAD_MUTEX_INITIALIZER;  // taken after the thread cache mutexes
 
 #if DEBUG_LEVEL >= _INFO_L
 #define GC_LOG
@@ -35,9 +77,6 @@ FILE* logfile;
 inline int translate2La(int local_addr) {
     return local_addr << 2;
 }
-inline int translate2Idx(int local_addr) {
-    return local_addr >> 2;
-}
 
 int getSize(const Type& type) {
     switch (type) {
@@ -76,10 +115,16 @@ void debugPrint(FILE* fp) {
  * @return int: Word index offset
  */
 int getWordForIdx(Type t, int idx) {
-    int wordsize = t == Type::BOOL ? 32 : 4;
-    int _count = wordsize / getSize(t);
-    int _idx = idx / _count;
-    return _idx;
+    switch (t) {
+        case Type::BOOL:
+            return idx >> 5;  // 32 bools to a word
+        case Type::CHAR:
+            return idx >> 2;  // 4 chars to a word
+        case Type::MEDIUM_INT:
+            return (idx * 3) >> 2;  // packed 3 bytes to an element, may span two words
+        default:
+            return idx;
+    }
 }
 
 /**
@@ -91,36 +136,139 @@ int getWordForIdx(Type t, int idx) {
  * @return int: Byte/bit level offset
  */
 int getOffsetForIdx(Type t, int idx) {
-    int wordsize = t == Type::BOOL ? 32 : 4;
-    int _count = wordsize / getSize(t);
-    int _idx = idx / _count;
-    return (idx - _idx * _count) * getSize(t);
+    switch (t) {
+        case Type::BOOL:
+            return idx & 31;
+        case Type::CHAR:
+            return idx & 3;
+        case Type::MEDIUM_INT:
+            return (idx * 3) & 3;
+        default:
+            return 0;
+    }
 }
 
 /**
  * @brief Construct a new Symbol Table:: Symbol Table object
- * @param _size: size of the symbol table
+ * @param _size: initial number of entries
+ * @param _maxCapacity: number of entries the table may grow to, at least _size
  */
-SymbolTable::SymbolTable(int _size) : size(0), head(0), tail(_size - 1), capacity(_size) {
-    symbols = new Symbol[capacity];
-    for (int i = 0; i < capacity; i++) {
-        symbols[i].word1 = 0;
-        symbols[i].word2 = ((i + 1)) << 1;
-    }
-    symbols[tail].word2 = -2;  // mark end of free list
+SymbolTable::SymbolTable(int _size, int _maxCapacity) : freeTop(0), size(0), capacity(0) {
+    maxCapacity = min(SYM_MAX_ENTRIES, max(_size, _maxCapacity));
+    segments = new Symbol*[(maxCapacity + SYM_SEGMENT_SIZE - 1) >> SYM_SEGMENT_SHIFT]();
     pthread_mutexattr_t attr;
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK_NP);
     pthread_mutex_init(&mutex, &attr);
+    pthread_mutex_init(&growMutex, &attr);
+    while (capacity < min(_size, maxCapacity)) {
+        addSegment();
+    }
     LOG("SymbolTable", _COLOR_BLUE, "Created SymbolTable with size %d\n", _size);
 }
 
 /**
- * @brief Destroy the Symbol Table object and the mutex
+ * @brief Destroy the Symbol Table object and the mutexes
  */
 SymbolTable::~SymbolTable() {
-    delete[] symbols;
+    for (int i = 0; i < capacity; i += SYM_SEGMENT_SIZE) {
+        delete[] segments[i >> SYM_SEGMENT_SHIFT];
+    }
+    delete[] segments;
     pthread_mutex_destroy(&mutex);
+    pthread_mutex_destroy(&growMutex);
+}
+
+/**
+ * @brief Adds the next segment to the table and pushes its entries on the free list,
+ *        growMutex must be held
+ *
+ * @return bool: false if the table is at maxCapacity
+ */
+bool SymbolTable::addSegment() {
+    int first = capacity;
+    int last = min(maxCapacity, first + SYM_SEGMENT_SIZE) - 1;
+    if (first > last) {
+        return false;
+    }
+    Symbol* seg = new Symbol[SYM_SEGMENT_SIZE];
+    for (int i = 0; i <= last - first; i++) {
+        seg[i].word1 = 0;
+        seg[i].word2 = (first + i + 2) << 1;
+        seg[i].gen = 0;
+        seg[i].pins = 0;
+        seg[i].renewed = 0;
+    }
+    segments[first >> SYM_SEGMENT_SHIFT] = seg;
+    __atomic_store_n(&capacity, last + 1, __ATOMIC_RELEASE);
+    // chain the new entries in front of the (possibly refilled) free list
+    unsigned long long top = __atomic_load_n(&freeTop, __ATOMIC_RELAXED);
+    unsigned long long newTop;
+    do {
+        __atomic_store_n(&at(last).word2, (unsigned int)top << 1, __ATOMIC_RELAXED);
+        newTop = (((top >> 32) + 1) << 32) | (first + 1);
+    } while (!__atomic_compare_exchange_n(&freeTop, &top, newTop, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    LOG("SymbolTable", _COLOR_BLUE, "Grew SymbolTable to %d entries\n", last + 1);
+    return true;
+}
+
+/**
+ * @brief Grows the table by a segment once the free list ran empty
+ *
+ * @return bool: false if the table is full
+ */
+bool SymbolTable::grow() {
+    PTHREAD_MUTEX_LOCK(&growMutex);
+    // another thread may have grown the table meanwhile
+    bool ok = (unsigned int)__atomic_load_n(&freeTop, __ATOMIC_ACQUIRE) != 0 || addSegment();
+    PTHREAD_MUTEX_UNLOCK(&growMutex);
+    return ok;
+}
+
+/**
+ * @brief Pops an entry off the lock-free free list, the tag in freeTop
+ *        is bumped on every update so a stale top can't be swapped in (ABA).
+ *        The table grows by a segment when the list is empty.
+ *
+ * @return int: index of the entry, -1 if the table is full
+ */
+int SymbolTable::pop() {
+    unsigned long long top = __atomic_load_n(&freeTop, __ATOMIC_ACQUIRE);
+    unsigned long long newTop;
+    unsigned int idx;
+    do {
+        idx = (unsigned int)top;
+        while (idx == 0) {
+            if (!grow()) {
+                return -1;
+            }
+            top = __atomic_load_n(&freeTop, __ATOMIC_ACQUIRE);
+            idx = (unsigned int)top;
+        }
+        unsigned int next = __atomic_load_n(&at(idx - 1).word2, __ATOMIC_RELAXED) >> 1;
+        newTop = (((top >> 32) + 1) << 32) | next;
+    } while (!__atomic_compare_exchange_n(&freeTop, &top, newTop, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    __atomic_add_fetch(&size, 1, __ATOMIC_RELAXED);
+    return idx - 1;
+}
+
+/**
+ * @brief Pushes an entry back on the lock-free free list and bumps its
+ *        generation, so that handles to the old entry are seen as stale
+ */
+void SymbolTable::push(unsigned int idx) {
+    Symbol& sym = at(idx);
+    __atomic_store_n(&sym.word1, 0, __ATOMIC_RELAXED);
+    // past every handle the entry had, renewed ones included
+    __atomic_add_fetch(&sym.gen, __atomic_load_n(&sym.renewed, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&sym.renewed, 0, __ATOMIC_RELEASE);
+    unsigned long long top = __atomic_load_n(&freeTop, __ATOMIC_RELAXED);
+    unsigned long long newTop;
+    do {
+        __atomic_store_n(&sym.word2, (unsigned int)top << 1, __ATOMIC_RELAXED);
+        newTop = (((top >> 32) + 1) << 32) | (idx + 1);
+    } while (!__atomic_compare_exchange_n(&freeTop, &top, newTop, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_sub_fetch(&size, 1, __ATOMIC_RELAXED);
 }
 
 /**
@@ -131,18 +279,66 @@ SymbolTable::~SymbolTable() {
  * @return int: index of the allocated entry
  */
 int SymbolTable::alloc(unsigned int wordidx, unsigned int offset) {
-    if (size == capacity) {
+    int idx = pop();
+    if (idx == -1) {
         return -1;
     }
-    unsigned int idx = head;
-    head = (symbols[head].word2 & -2) >> 1;
-    symbols[idx].word1 = (wordidx << 1) | 1;  // mark as allocated
-    symbols[idx].word2 = (offset << 1) | 1;   // mark as in use
-    size++;
-    LOG("SymbolTable", _COLOR_BLUE, "Alloc symbol: %d at address: %d\n", idx, translate2La(wordidx) | offset);
+    assign(idx, wordidx, offset);
     return idx;
 }
 
+/**
+ * @brief Fills an already taken (reserved) entry of the symbol table
+ *
+ * @param idx: index of the entry
+ * @param wordidx: word index in the logic memory
+ * @param offset: offset (byte-level) in the word
+ */
+void SymbolTable::assign(unsigned int idx, unsigned int wordidx, unsigned int offset) {
+    __atomic_store_n(&at(idx).word2, (offset << 1) | 1, __ATOMIC_RELAXED);   // mark as in use
+    __atomic_store_n(&at(idx).word1, (wordidx << 1) | 1, __ATOMIC_RELEASE);  // mark as allocated
+    LOG("SymbolTable", _COLOR_BLUE, "Alloc symbol: %d at address: %d\n", idx, translate2La(wordidx) | offset);
+}
+
+/**
+ * @brief Fills a reserved entry of the symbol table with a scalar kept in a slab slot
+ *
+ * @param idx: index of the entry
+ * @param slab: symbol of the slab
+ * @param offset: offset of the slot in the slab payload (see SlabClass::slotOffset())
+ */
+void SymbolTable::assignSlot(unsigned int idx, unsigned int slab, unsigned int offset) {
+    __atomic_store_n(&at(idx).word2, (offset << 1) | 1, __ATOMIC_RELAXED);             // mark as in use
+    __atomic_store_n(&at(idx).word1, SYM_SLOT | (slab << 1) | 1, __ATOMIC_RELEASE);  // mark as allocated
+    LOG("SymbolTable", _COLOR_BLUE, "Alloc symbol: %d in slab: %d at offset: %d\n", idx, slab, offset);
+}
+
+/**
+ * @brief Takes up to n entries off the free list without allocating them,
+ *        so that a thread can later fill them on its own
+ *
+ * @param n: number of entries wanted
+ * @param[out] out: indices of the reserved entries
+ * @return int: number of entries reserved
+ */
+int SymbolTable::reserve(int n, int* out) {
+    int count = 0;
+    int idx;
+    while (count < n && (idx = pop()) != -1) {
+        at(idx).word1 = 0;
+        at(idx).word2 = 1;  // not allocated, but never seen as garbage
+        out[count++] = idx;
+    }
+    return count;
+}
+
+/**
+ * @brief Returns a reserved (unallocated) entry to the free list
+ */
+void SymbolTable::unreserve(unsigned int idx) {
+    push(idx);
+}
+
 /**
  * @brief Frees the given symbol if allocated else throws an exception
  * @throws std::exception: if the symbol is not allocated throw a runtime error
@@ -153,21 +349,25 @@ void SymbolTable::free(unsigned int idx) {
     }
     unsigned int wordidx = getWordIdx(idx);
     unsigned int offset = getOffset(idx);
-    if (size == capacity) {
-        head = tail = idx;
-        symbols[idx].word1 = 0;
-        symbols[idx].word2 = -2;  // sentinel
-        size--;
-        return;
-    }
-    symbols[tail].word2 = idx << 1;
-    symbols[idx].word1 = 0;
-    symbols[idx].word2 = -2;  // sentinel
-    tail = idx;
-    size--;
+    push(idx);
     LOG("SymbolTable", _COLOR_BLUE, "Freed symbol: %d at address: %d\n", idx, translate2La(wordidx) | offset);
 }
 
+/**
+ * @brief Drops one pin of a symbol
+ *
+ * @param idx: index of the symbol
+ * @return bool: false if the symbol was not pinned
+ */
+bool SymbolTable::unpin(unsigned int idx) {
+    unsigned int count = __atomic_load_n(&at(idx).pins, __ATOMIC_RELAXED);
+    do {
+        if (count == 0)
+            return false;
+    } while (!__atomic_compare_exchange_n(&at(idx).pins, &count, count - 1, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return true;
+}
+
 /**
  * @brief Returns the pointer to the logical address of the symbol in the main memory
  *
@@ -183,45 +383,116 @@ int* SymbolTable::getPtr(unsigned int idx) {
 }
 
 Stack::Stack(int size) : _top(-1), capacity(size) {
-    _elems = new int[capacity];
+    _elems = new Handle[capacity];
 }
 Stack::~Stack() {
     delete[] _elems;
 }
-void Stack::push(int elem) {
+void Stack::push(Handle elem) {
     if (_top == capacity - 1) {
-        throw std::runtime_error("Stack::push: stack overflow");
+        Handle* elems = new Handle[capacity << 1];
+        memcpy(elems, _elems, capacity * sizeof(Handle));
+        delete[] _elems;
+        _elems = elems;
+        capacity <<= 1;
     }
     _elems[++_top] = elem;
-    LOG("Stack", _COLOR_BLUE, "Pushed %d\n", elem);
+    LOG("Stack", _COLOR_BLUE, "Pushed %llx\n", elem);
 }
 
-int Stack::pop() {
-    LOG("Stack", _COLOR_BLUE, "Popped %d\n", _elems[_top]);
+Handle Stack::pop() {
+    LOG("Stack", _COLOR_BLUE, "Popped %llx\n", _elems[_top]);
     return _elems[_top--];
 }
 
-int Stack::top() { return _elems[_top]; }
+Handle Stack::top() { return _elems[_top]; }
+
+/**
+ * @brief Maps a block size to its (first level, second level) free list
+ *
+ * @param words: size of the block in words (>= MIN_LIST_WORDS)
+ * @param[out] fl: first level index, floor(log2(words))
+ * @param[out] sl: second level index, next SL_BITS bits after the leading one
+ */
+inline void mapSizeClass(int words, int& fl, int& sl) {
+    fl = 31 - __builtin_clz(words);
+    sl = (words >> (fl - SL_BITS)) & (SL_COUNT - 1);
+}
 
 /**
  * @brief Creates a memory block of given size (4 byte aligned)
  * @param _size: size of the memory block in bytes
  */
-void MemBlock::Init(int _size) {
+void MemBlock::Init(int _size, int _extra, int _max, PageMode _pages) {
     int size = (((_size + 3) >> 2) << 2);  // align to 4 bytes
-    mem = (int*)malloc(size);
-    start = mem;
-    end = mem + (size >> 2);
-    *start = (size >> 2) << 1;                      // 31 bits store size last bit for if free or not
-    *(start + (size >> 2) - 1) = (size >> 2) << 1;  // footer
-    totalFreeMem = size >> 2;
-    totalFreeBlocks = 1;
-    biggestFreeBlockSize = size >> 2;
+    // the address range of the largest heap is reserved up front so that word
+    // offsets (and pinned views) stay valid as chunks are committed
+    void* base = MAP_FAILED;
+    size_t heapBytes = 0;
+    for (int mode = _pages; base == MAP_FAILED && mode >= SMALL_PAGES; mode--) {
+        pageMode = (PageMode)mode;
+        pageBytes = pageMode == SMALL_PAGES ? sysconf(_SC_PAGESIZE) : HUGE_PAGE_SIZE;
+        heapBytes = ((size_t)max(size, _max) + pageBytes - 1) / pageBytes * pageBytes;
+        reserved = heapBytes + ((size_t)_extra + pageBytes - 1) / pageBytes * pageBytes;  // _extra bytes after limit are left to the caller
+        base = reserve(reserved);
+    }
+    if (base == MAP_FAILED)
+        throw std::runtime_error("Error reserving heap memory");
+    mem = start = end = (int*)base;
+    limit = start + (heapBytes >> 2);
+    growable = _max > size;
+    chunks.clear();
+    resetFreeLists();
+    if (_extra > 0)
+        commit(limit, limit + (_extra >> 2));
+    addChunk(size >> 2);
     pthread_mutexattr_t attr;
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK_NP);
     pthread_mutex_init(&mutex, &attr);
-    LOG("MemBlock", _COLOR_BLUE, "Created Memory block with size %d bytes\n", size);
+    LOG("MemBlock", _COLOR_BLUE, "Created Memory block with size %d bytes, %s\n", size, pageModeName(pageMode));
+}
+
+/**
+ * @brief Tells if transparent huge pages can be asked for with madvise
+ */
+static bool thpEnabled() {
+    FILE* fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (fp == nullptr)
+        return false;
+    char buf[128] = {0};
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    return n > 0 && strstr(buf, "[never]") == nullptr;
+}
+
+/**
+ * @brief Maps bytes bytes of address space in pageMode: hugetlb pages are taken
+ *        from the preallocated pool when mapping (they can't be reserved lazily),
+ *        transparent huge pages need a range aligned to HUGE_PAGE_SIZE
+ *
+ * @return void*: start of the range, MAP_FAILED if the mode is not available
+ */
+void* MemBlock::reserve(size_t bytes) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (pageMode == HUGETLB_PAGES)
+        return mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (pageMode == SMALL_PAGES)
+        return mmap(nullptr, bytes, PROT_NONE, flags | MAP_NORESERVE, -1, 0);
+    if (!thpEnabled())
+        return MAP_FAILED;
+    char* raw = (char*)mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_NONE, flags | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED)
+        return MAP_FAILED;
+    char* base = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (base > raw)
+        munmap(raw, base - raw);
+    munmap(base + bytes, raw + HUGE_PAGE_SIZE - base);
+    if (madvise(base, bytes, MADV_HUGEPAGE) != 0) {
+        munmap(base, bytes);
+        return MAP_FAILED;
+    }
+    return base;
 }
 
 /**
@@ -229,65 +500,337 @@ void MemBlock::Init(int _size) {
  *
  */
 MemBlock::~MemBlock() {
-    free(start);
+    munmap(start, reserved);
     pthread_mutex_destroy(&mutex);
     LOG("MemBlock", _COLOR_BLUE, "Destroyed Memory block\n");
 }
 
 /**
- * @brief Find the first free block of size >= input_size
- *        and returns word-level offset from base pointer
+ * @brief Makes the reserved pages covering [from, to) readable and writable
+ */
+void MemBlock::commit(int* from, int* to) {
+    uintptr_t page = pageBytes;
+    uintptr_t lo = (uintptr_t)from & ~(page - 1);
+    uintptr_t hi = ((uintptr_t)to + page - 1) & ~(page - 1);
+    if (mprotect((void*)lo, hi - lo, PROT_READ | PROT_WRITE) != 0)
+        throw std::runtime_error("Error committing heap memory");
+}
+
+/**
+ * @brief Commits a chunk of words words at the end of the heap as one free block.
+ *        Chunks of a growable heap end with a MIN_BLOCK_WORDS allocated fencepost
+ *        so that no block ever spans two chunks: free blocks don't coalesce over
+ *        it and compaction doesn't move blocks across it (see compactMem()).
+ *
+ * @return bool: false if the reserved range can't fit a chunk
+ */
+bool MemBlock::addChunk(int words) {
+    words = min((long)words, (long)(limit - end));
+    int fence = growable ? MIN_BLOCK_WORDS : 0;
+    if (words - fence < MIN_BLOCK_WORDS)
+        return false;
+    commit(end, end + words);
+    HeapChunk c;
+    c.begin = end - start;
+    c.end = c.begin + words;
+    c.freeWords = 0;
+    chunks.push_back(c);
+    int* p = end;
+    int freeWords = words - fence;
+    *p = freeWords << 1;
+    *(p + freeWords - 1) = freeWords << 1;
+    if (fence > 0) {
+        *(p + freeWords) = (fence << 1) | 1;
+        *(p + words - 1) = (fence << 1) | 1;
+    }
+    end += words;
+    insertFree(p);
+    LOG("MemBlock", _COLOR_BLUE, "Added heap chunk of %d bytes, heap is %ld bytes\n", words << 2, (long)(end - start) << 2);
+    return true;
+}
+
+/**
+ * @brief Grows the heap by a chunk that fits a block of words words, chunks at
+ *        least double the heap (and are HEAP_GROW_MIN_BYTES or more) up to the
+ *        limit. mem->mutex must be held.
+ *
+ * @return bool: false if the heap is not growable or reached its limit
+ */
+bool MemBlock::grow(int words) {
+    if (!growable)
+        return false;
+    long want = max((long)words + MIN_BLOCK_WORDS, max((long)(end - start), (long)HEAP_GROW_MIN_BYTES >> 2));
+    if (want > limit - end)
+        want = limit - end;
+    if (want < (long)words + MIN_BLOCK_WORDS)
+        return false;
+    return addChunk(want);
+}
+
+/**
+ * @brief Returns the pages inside free blocks of at least HEAP_RELEASE_MIN_BYTES
+ *        to the OS, they read as zeros when reused. The header, links and footer
+ *        of a block stay resident. mem->mutex must be held.
+ *
+ * @return long: bytes released
+ */
+long MemBlock::releaseFree() {
+    int minWords = max((size_t)HEAP_RELEASE_MIN_BYTES, pageBytes << 1) >> 2;
+    uintptr_t page = pageBytes;  // releasing part of a huge page would split it
+    long released = 0;
+    int fl, sl;
+    mapSizeClass(minWords, fl, sl);
+    for (int i = fl * SL_COUNT; i < FL_COUNT * SL_COUNT; i++) {
+        for (int p = freeLists[i]; p != -1; p = *(start + p + 1)) {
+            int words = *(start + p) >> 1;
+            if (words < minWords)
+                continue;
+            uintptr_t lo = ((uintptr_t)(start + p + MIN_LIST_WORDS - 1) + page - 1) & ~(page - 1);
+            uintptr_t hi = (uintptr_t)(start + p + words - 1) & ~(page - 1);
+            if (hi > lo && madvise((void*)lo, hi - lo, HEAP_RELEASE_ADVICE) == 0)
+                released += hi - lo;
+        }
+    }
+    LOG("MemBlock", _COLOR_BLUE, "Released %ld bytes of free blocks\n", released);
+    return released;
+}
+
+/**
+ * @brief Returns the chunk holding the word offset wordid
+ */
+HeapChunk& MemBlock::chunkOf(int wordid) {
+    size_t lo = 0, hi = chunks.size() - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi + 1) >> 1;
+        if (chunks[mid].begin <= wordid)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return chunks[lo];
+}
+
+/**
+ * @brief Empties all free lists and resets the free memory book keeping
+ */
+void MemBlock::resetFreeLists() {
+    flBitmap = 0;
+    memset(slBitmap, 0, sizeof(slBitmap));
+    for (int i = 0; i < FL_COUNT * SL_COUNT; i++) {
+        freeLists[i] = -1;
+    }
+    tinyList = -1;
+    tinyCount = 0;
+    totalFreeMem = 0;
+    totalFreeBlocks = 0;
+    biggestFreeBlockSize = 0;
+    for (HeapChunk& c : chunks) {
+        c.freeWords = 0;
+    }
+}
+
+/**
+ * @brief Adds a free block to the free list of its size class
+ *        (or to the tiny list if it is too small to hold the links)
+ *
+ * @param ptr: pointer to the header of the free block
+ */
+void MemBlock::insertFree(int* ptr) {
+    int words = *ptr >> 1;
+    int wordid = ptr - start;
+    totalFreeMem += words;
+    totalFreeBlocks++;
+    chunkOf(wordid).freeWords += words;
+    biggestFreeBlockSize = max(biggestFreeBlockSize, words);
+    if (words < MIN_LIST_WORDS) {
+        *ptr = (words << 1) | 1;  // tagged as allocated, see TINY_FOOTER
+        *(ptr + words - 1) = TINY_FOOTER(-1);
+        *(ptr + 1) = tinyList;
+        if (tinyList != -1) {
+            *(start + tinyList + MIN_BLOCK_WORDS - 1) = TINY_FOOTER(wordid);
+        }
+        tinyList = wordid;
+        tinyCount++;
+        return;
+    }
+    int fl, sl;
+    mapSizeClass(words, fl, sl);
+    int& head = freeLists[fl * SL_COUNT + sl];
+    *(ptr + 1) = head;  // next
+    *(ptr + 2) = -1;    // prev
+    if (head != -1) {
+        *(start + head + 2) = wordid;
+    }
+    head = wordid;
+    flBitmap |= 1u << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+/**
+ * @brief Unlinks a free block (>= MIN_LIST_WORDS) from its free list
+ *
+ * @param ptr: pointer to the header of the free block
+ */
+void MemBlock::removeFree(int* ptr) {
+    int words = *ptr >> 1;
+    int fl, sl;
+    mapSizeClass(words, fl, sl);
+    int next = *(ptr + 1), prev = *(ptr + 2);
+    if (prev != -1) {
+        *(start + prev + 1) = next;
+    } else {
+        freeLists[fl * SL_COUNT + sl] = next;
+        if (next == -1) {
+            slBitmap[fl] &= ~(1u << sl);
+            if (slBitmap[fl] == 0) {
+                flBitmap &= ~(1u << fl);
+            }
+        }
+    }
+    if (next != -1) {
+        *(start + next + 2) = prev;
+    }
+    totalFreeMem -= words;
+    totalFreeBlocks--;
+    chunkOf(ptr - start).freeWords -= words;
+    if (words == biggestFreeBlockSize) {
+        updateBiggest();
+    }
+}
+
+/**
+ * @brief Unlinks a tiny free block from the tiny list, the block is left
+ *        tagged as an allocated block of MIN_BLOCK_WORDS words
+ *
+ * @param ptr: pointer to the header of the tiny block
+ */
+void MemBlock::removeTiny(int* ptr) {
+    int next = *(ptr + 1), prev = TINY_PREV(*(ptr + MIN_BLOCK_WORDS - 1));
+    if (prev != -1) {
+        *(start + prev + 1) = next;
+    } else {
+        tinyList = next;
+    }
+    if (next != -1) {
+        *(start + next + MIN_BLOCK_WORDS - 1) = TINY_FOOTER(prev);
+    }
+    *(ptr + MIN_BLOCK_WORDS - 1) = (MIN_BLOCK_WORDS << 1) | 1;
+    tinyCount--;
+    totalFreeMem -= MIN_BLOCK_WORDS;
+    totalFreeBlocks--;
+    chunkOf(ptr - start).freeWords -= MIN_BLOCK_WORDS;
+    if (tinyCount == 0 && biggestFreeBlockSize == MIN_BLOCK_WORDS) {
+        updateBiggest();
+    }
+}
+
+/**
+ * @brief Recomputes the exact size of the biggest free block,
+ *        only the highest non-empty size class has to be scanned
+ */
+void MemBlock::updateBiggest() {
+    if (flBitmap == 0) {
+        biggestFreeBlockSize = tinyCount > 0 ? MIN_BLOCK_WORDS : 0;
+        return;
+    }
+    int fl = 31 - __builtin_clz(flBitmap);
+    int sl = 31 - __builtin_clz(slBitmap[fl]);
+    int biggest = 0;
+    for (int p = freeLists[fl * SL_COUNT + sl]; p != -1; p = *(start + p + 1)) {
+        biggest = max(biggest, *(start + p) >> 1);
+    }
+    biggestFreeBlockSize = biggest;
+}
+
+/**
+ * @brief Finds a free block of size >= words in O(1) using the size class bitmaps,
+ *        the request is rounded up to the next size class so that any block of
+ *        that class fits. Falls back to a first fit over the exact class list.
+ *
+ * @param words: size of the block required in words
+ * @return int*: pointer to the free block, nullptr if none found
+ */
+int* MemBlock::findFree(int words) {
+    words = max(words, MIN_LIST_WORDS);
+    int fl, sl;
+    mapSizeClass(words, fl, sl);
+    int rfl = fl, rsl = sl;
+    if (fl < FL_COUNT - 1) {
+        mapSizeClass(words + (1 << (fl - SL_BITS)) - 1, rfl, rsl);
+    }
+    unsigned int slMap = slBitmap[rfl] & (~0u << rsl);
+    if (slMap == 0) {
+        unsigned int flMap = rfl + 1 < FL_COUNT ? flBitmap & (~0u << (rfl + 1)) : 0;
+        if (flMap != 0) {
+            rfl = __builtin_ctz(flMap);
+            slMap = slBitmap[rfl];
+        }
+    }
+    if (slMap != 0) {
+        return start + freeLists[rfl * SL_COUNT + __builtin_ctz(slMap)];
+    }
+    // blocks in the request's own class may still be big enough
+    for (int p = freeLists[fl * SL_COUNT + sl]; p != -1; p = *(start + p + 1)) {
+        if ((*(start + p) >> 1) >= words) {
+            return start + p;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Finds a free block of size >= input_size from the segregated
+ *        free lists and returns word-level offset from base pointer
  *
  * @param size: size of the free block required in bytes
  * @return int: word-level offset from base pointer
  */
 int MemBlock::getMem(int size) {
-    int* p = start;
-    int newsize = (((size + 3) >> 2) << 2) + 8;  // align to 4 bytes + 8 bytes for header and footer
-    // find the first free block of size >= newsize
-    while ((p < end) &&
-           ((*p & 1) ||
-            ((*p << 1) < newsize))) {
-        p = p + (*p >> 1);
-    }
-    // if no free block found, return -1
-    if (p == end) {
-        return -1;
+    int words = max(((size + 3) >> 2) + 2, MIN_BLOCK_WORDS);  // align to 4 bytes + header and footer
+    int* p = nullptr;
+    if (words == MIN_BLOCK_WORDS && tinyList != -1) {
+        // tiny blocks are already tagged as allocated
+        p = start + tinyList;
+        removeTiny(p);
+    } else {
+        p = findFree(words);
+        // if no free block found, return -1
+        if (p == nullptr) {
+            return -1;
+        }
+        // split it into two blocks (allocate and free) if possible
+        splitBlock(p, words << 2);
     }
-    // if free block found, split it into two blocks (allocate and free) if possible
-    splitBlock((int*)p, newsize);
 #ifdef GC_LOG
     fprintf(logfile, "%ld\n", ((end - start) - totalFreeMem));
 #endif
-    LOG("MemBlock", _COLOR_BLUE, "Alloc %d bytes at address: %d\n", newsize, (int)(p - start) << 2);
+    LOG("MemBlock", _COLOR_BLUE, "Alloc %d bytes at address: %d\n", words << 2, (int)(p - start) << 2);
     return (p - start);
 }
 
 /**
- * @brief Splits a free block with first block allocated and second block free (if possible)
+ * @brief Splits a free block with first block allocated and second block free (if possible),
+ *        remainders too small to be a block are handed out with the allocation
  *
  * @param ptr: pointer to the free block
  * @param size: size of the allocated block
  */
 void MemBlock::splitBlock(int* ptr, int size) {
-    int oldsize = *ptr << 1;  // old size in bytes
+    int oldwords = *ptr >> 1;
     int words = size >> 2;
+    removeFree(ptr);
+    if (oldwords - words < MIN_BLOCK_WORDS) {
+        words = oldwords;
+    }
     *ptr = (words << 1) | 1;
     *(ptr + words - 1) = (words << 1) | 1;  // footer
-    if (size < oldsize) {
-        *(ptr + words) = (oldsize - size) >> 1;
-        *(ptr + (oldsize >> 2) - 1) = (oldsize - size) >> 1;
+    if (words < oldwords) {
+        int* rem = ptr + words;
+        *rem = (oldwords - words) << 1;
+        *(ptr + oldwords - 1) = (oldwords - words) << 1;
+        insertFree(rem);
     }
     LOG("MemBlock", _COLOR_BLUE, "Split block at address: %d\n", (int)(ptr - start) << 2);
-    // book keeping for compaction
-    totalFreeMem -= words;
-    if (size == oldsize) {
-        totalFreeBlocks--;
-    }
-    if ((oldsize >> 2) == biggestFreeBlockSize) {
-        biggestFreeBlockSize -= words;
-    }
-    biggestFreeBlockSize = max(biggestFreeBlockSize, totalFreeMem / (totalFreeBlocks + 1));
 }
 
 /**
@@ -300,27 +843,28 @@ void MemBlock::freeBlock(int wordid) {
     int* ptr = start + wordid;
     int words = *ptr >> 1;
     int orig_words = words;
-    *ptr = *ptr & -2;                // mark as free
-    *(ptr + words - 1) = *ptr & -2;  // mark as free
-    totalFreeBlocks++;
-    totalFreeMem += words;
 
     int* next = ptr + words;
     if (next != end && (*next & 1) == 0) {  // next is also free so coelesce
+        removeFree(next);
         words = words + (*next >> 1);
-        *ptr = words << 1;                        // new size in words
-        *(next + (*next >> 1) - 1) = words << 1;  // footer
-        totalFreeBlocks--;
+    } else if (next != end && *next == ((MIN_BLOCK_WORDS << 1) | 1) && IS_TINY_FOOTER(*(next + MIN_BLOCK_WORDS - 1))) {
+        removeTiny(next);
+        words = words + MIN_BLOCK_WORDS;
     }
     if (ptr != start && (*(ptr - 1) & 1) == 0) {  // previous is also free so coelesce
         int prevwords = (*(ptr - 1) >> 1);
-        *(ptr - prevwords) = (prevwords + words) << 1;  // new size in words
-        *(ptr + words - 1) = (prevwords + words) << 1;  // footer
+        ptr = ptr - prevwords;
+        removeFree(ptr);
         words = words + prevwords;
-        totalFreeBlocks--;
+    } else if (ptr != start && IS_TINY_FOOTER(*(ptr - 1))) {
+        ptr = ptr - MIN_BLOCK_WORDS;
+        removeTiny(ptr);
+        words = words + MIN_BLOCK_WORDS;
     }
-    biggestFreeBlockSize = max(biggestFreeBlockSize, words);
-    biggestFreeBlockSize = max(biggestFreeBlockSize, totalFreeMem / (totalFreeBlocks + 1));
+    *ptr = words << 1;                // new size in words, mark as free
+    *(ptr + words - 1) = words << 1;  // footer
+    insertFree(ptr);
 #ifdef GC_LOG
     fprintf(logfile, "%ld\n", ((end - start) - totalFreeMem));
 #endif
@@ -328,114 +872,722 @@ void MemBlock::freeBlock(int wordid) {
 }
 
 /**
- * @brief Allocates heap-memory of given size
+ * @brief Grows the allocated block at wordid to words words in place by absorbing
+ *        the free block right after it, the surplus is split off again
  *
- * @param size: size of the memory to be allocated
- * @param gc: if true, garbage collector is created
+ * @param wordid: word-level offset of the block
+ * @param words: size wanted in words (header and footer included)
+ * @return bool: false if the next block is not a free block big enough
  */
-void createMem(int size, bool gc) {
-    if (mem != nullptr)
-        throw std::runtime_error("Memory already created");
-    mem = new MemBlock();
-    mem->Init(size * EFFEC_MEM_RATIO);
-    int symtable_size = min((1 << 15), (int)((size * EFFEC_MEM_RATIO) + 11) / 12);
-    symTable = new SymbolTable(symtable_size);
-    stack = new Stack(symtable_size);
-    string fname = gc ? "gc" : "non_gc";
-#ifdef GC_LOG
-    logfile = fopen((fname + ".csv").c_str(), "w");
-    fprintf(logfile, "%s\n", fname.c_str());
-#endif
-    if (gc) {
-        sem_init(&sem_gc, 0, 0);  // initialize semaphore for garbage collector
-                                  // thread to perform initializations
-        signal(SIGUSR1, SIG_IGN);
-        signal(SIGUSR2, SIG_IGN);
-        int ret = pthread_create(&gcThread, nullptr, garbageCollector, nullptr);
-        if (ret != 0) {
-            throw std::runtime_error("Error creating garbage collector thread");
-        }
-        sem_wait(&sem_gc);
-        LOG("createMem", _COLOR_BLUE, "Garbage collector thread created\n");
-        gc_active = true;
+bool MemBlock::extendBlock(int wordid, int words) {
+    int* ptr = start + wordid;
+    int have = *ptr >> 1;
+    int* next = ptr + have;
+    if (next == end || (*next & 1) || have + (*next >> 1) < words)
+        return false;
+    int total = have + (*next >> 1);
+    removeFree(next);
+    if (total - words < MIN_BLOCK_WORDS) {
+        words = total;
+    }
+    *ptr = (words << 1) | 1;
+    *(ptr + words - 1) = (words << 1) | 1;  // footer
+    if (words < total) {
+        int* rem = ptr + words;
+        *rem = (total - words) << 1;
+        *(ptr + total - 1) = (total - words) << 1;
+        insertFree(rem);
     }
+    LOG("MemBlock", _COLOR_BLUE, "Extended block at address: %d to %d bytes\n", wordid << 2, words << 2);
+    return true;
 }
 
 /**
- * @brief Create an object of given Type t and returns a Ptr struct object
+ * @brief Shrinks the allocated block at wordid to words words, the tail is freed
+ *        (and coalesced) unless it is too small to be a block
  *
- * @param t: type of the object to be created
- * @return Ptr: Ptr to the created object
+ * @param wordid: word-level offset of the block
+ * @param words: size wanted in words (header and footer included)
  */
-Ptr createVar(const Type& t) {
-    int _size = getSize(t);
-    _size = (((_size + 3) >> 2) << 2);
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int wordid = mem->getMem(_size);
-    if (wordid == -1) {
-        PTHREAD_MUTEX_LOCK(&symTable->mutex);
-        compactMem();
-        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
-        wordid = mem->getMem(_size);
-        if (wordid == -1)
-            throw std::runtime_error("Out of memory");
-    }
-    PTHREAD_MUTEX_LOCK(&symTable->mutex);
-    int local_addr = symTable->alloc(wordid, 0);
-    if (local_addr == -1)
-        throw std::runtime_error("Out of memory in symbol table");
-    LOG("createVar", _COLOR_BLUE, "Created variable at local address: %d\n", translate2La(local_addr));
-    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
-    stack->push(local_addr);
-    return Ptr(t, translate2La(local_addr));
+void MemBlock::shrinkBlock(int wordid, int words) {
+    int* ptr = start + wordid;
+    int have = *ptr >> 1;
+    if (have - words < MIN_BLOCK_WORDS)
+        return;
+    *ptr = (words << 1) | 1;
+    *(ptr + words - 1) = (words << 1) | 1;  // footer
+    *(ptr + words) = ((have - words) << 1) | 1;
+    *(ptr + have - 1) = ((have - words) << 1) | 1;
+    freeBlock(wordid + words);
 }
 
 /**
- * @brief Creates an array object of baseType t and size: width and returns a Ptr struct object
- *
- * @param t: Base type of the array
- * @param width: size of the array
- * @return ArrPtr: Ptr to the created array
+ * @brief Construct a new Nursery:: Nursery object
+ * @param _base: word offset of the first semispace
+ * @param _words: size of each semispace in words
  */
-ArrPtr createArr(const Type& t, int width) {
-    int wordsize = t == Type::BOOL ? 32 : 4;
-    int _count = wordsize / getSize(t);
-    int _width = (width + _count - 1) / _count;  // round up
-    int _size = _width << 2;
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int wordid = mem->getMem(_size);
-    if (wordid == -1) {
-        // In case of out of memory, try and compact the memory, if that also fails, throw exception
-        PTHREAD_MUTEX_LOCK(&symTable->mutex);
-        compactMem();
-        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
-        wordid = mem->getMem(_size);
-        if (wordid == -1)
-            throw std::runtime_error("Out of memory");
-    }
-    PTHREAD_MUTEX_LOCK(&symTable->mutex);
-    int local_addr = symTable->alloc(wordid, 0);
-    if (local_addr == -1)
-        throw std::runtime_error("Out of memory in symbol table");
-    LOG("createArr", _COLOR_BLUE, "Created array at local address: %d\n", translate2La(local_addr));
-    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
-    stack->push(local_addr);
-    return ArrPtr(t, translate2La(local_addr), width);
+Nursery::Nursery(int _base, int _words) : words(_words), active(0), top(_base) {
+    base[0] = _base;
+    base[1] = _base + _words;
+    LOG("Nursery", _COLOR_BLUE, "Created nursery with 2 semispaces of %d bytes\n", _words << 2);
 }
 
 /**
- * @brief Get the value of the object pointed by the Ptr and stores it in val
+ * @brief Bumps n words off the active semispace, mem->mutex must be held
  *
- * @param[in] p: Ptr to the object
- * @param[out] val: storing the value of the object
+ * @param n: number of words
+ * @return int: word offset of the range, -1 if the semispace is full
  */
-void getVar(const Ptr& p, void* val) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
+int Nursery::take(int n) {
+    if (top + n > base[active] + words) {
+        return -1;
+    }
+    int wordid = top;
+    top += n;
+    return wordid;
+}
+
+/**
+ * @brief Tags n words at wordid as a block without an object,
+ *        the space is reclaimed by the next minor collection
+ */
+void Nursery::fill(int wordid, int n) {
+    int* p = mem->start + wordid;
+    *p = (n << 1) | 1;
+    *(p + n - 1) = NURSERY_FILLER;
+}
+
+ThreadCache::ThreadCache() : cur(0), end(0), symCount(0), stack(nullptr), inAccess(0), next(nullptr) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK_NP);
+    pthread_mutex_init(&mutex, &attr);
+}
+
+ThreadCache::~ThreadCache() {
+    delete stack;
+    pthread_mutex_destroy(&mutex);
+}
+
+/**
+ * @brief Carves a block of given size from the front of the allocation buffer,
+ *        the rest of the buffer is kept as one allocated block
+ *
+ * @param words: size of the block in words (header and footer included)
+ * @return int: word-level offset of the block, -1 if the buffer is too small
+ */
+int ThreadCache::bump(int words) {
+    int avail = end - cur;
+    if (words > avail) {
+        return -1;
+    }
+    if (avail - words < MIN_BLOCK_WORDS) {
+        words = avail;
+    }
+    int* p = mem->start + cur;
+    *p = (words << 1) | 1;
+    *(p + words - 1) = (words << 1) | 1;  // footer
+    int wordid = cur;
+    cur += words;
+    if (cur < end) {
+        *(mem->start + cur) = ((end - cur) << 1) | 1;
+    }
+    return wordid;
+}
+
+/**
+ * @brief Returns the unused part of the buffer to the heap and takes a new one
+ *        (from the nursery in generational mode),
+ *        mem->mutex must be held
+ */
+void ThreadCache::refill() {
+    retire();
+    int wordid;
+    if (nursery != nullptr) {
+        wordid = nursery->take(tlabWords);
+        if (wordid != -1)
+            nursery->fill(wordid, tlabWords);
+    } else {
+        wordid = mem->getMem((tlabWords - 2) << 2);
+    }
+    if (wordid == -1) {
+        return;
+    }
+    cur = wordid;
+    end = wordid + (*(mem->start + wordid) >> 1);
+    pacerAlloc(end - cur);
+    LOG("ThreadCache", _COLOR_BLUE, "Refilled allocation buffer at address: %d\n", translate2La(cur));
+}
+
+/**
+ * @brief Returns the unused part of the buffer to the heap, mem->mutex must be held
+ */
+void ThreadCache::retire() {
+    if (cur < end) {
+        if (nursery != nullptr)
+            nursery->fill(cur, end - cur);
+        else
+            mem->freeBlock(cur);
+    }
+    cur = end = 0;
+}
+
+/**
+ * @brief Returns the reserved symbol table entries
+ */
+void ThreadCache::releaseSymbols() {
+    while (symCount > 0) {
+        symTable->unreserve(symbols[--symCount]);
+    }
+}
+
+/**
+ * @brief Unmarks every variable still in an open scope of the thread
+ *        so that the garbage collector can reclaim it
+ */
+void ThreadCache::dropScopes() {
+    while (stack != nullptr && stack->_top >= 0) {
+        int local_addr = symTable->lookupScoped(stack->pop());
+        if (local_addr != -1 && symTable->isAllocated(local_addr)) {
+            symTable->setUnmarked(local_addr);
+            garbage.push_back(local_addr);
+            __atomic_add_fetch(&pendingGarbage, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void destroyThreadCache(void* arg) {
+    ThreadCache* tc = (ThreadCache*)arg;
+    bool alive = mem != nullptr;
+    if (alive) {
+        PTHREAD_MUTEX_LOCK(&mem->mutex);
+    }
+    PTHREAD_MUTEX_LOCK(&cacheMutex);
+    ThreadCache** pp = &caches;
+    while (*pp != tc) {
+        pp = &(*pp)->next;
+    }
+    *pp = tc->next;
+    if (alive) {
+        tc->retire();
+        tc->releaseSymbols();
+        tc->dropScopes();
+        orphanGarbage.insert(orphanGarbage.end(), tc->garbage.begin(), tc->garbage.end());
+    }
+    PTHREAD_MUTEX_UNLOCK(&cacheMutex);
+    if (alive) {
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        gcNotify();
+    }
+    delete tc;
+}
+
+void createCacheKey() {
+    pthread_key_create(&cacheKey, destroyThreadCache);
+}
+
+/**
+ * @brief Returns the calling thread's cache, registering it on first use
+ */
+ThreadCache* getThreadCache() {
+    if (tcache == nullptr) {
+        pthread_once(&cacheKeyOnce, createCacheKey);
+        tcache = new ThreadCache();
+        PTHREAD_MUTEX_LOCK(&cacheMutex);
+        tcache->next = caches;
+        caches = tcache;
+        PTHREAD_MUTEX_UNLOCK(&cacheMutex);
+        pthread_setspecific(cacheKey, tcache);
+    }
+    if (tcache->stack == nullptr) {
+        tcache->stack = new Stack(SCOPE_STACK_SIZE);
+    }
+    return tcache;
+}
+
+/**
+ * @brief Stops all mutator threads from allocating by taking every thread cache mutex,
+ *        lock order is mem->mutex, symTable->mutex, then the thread caches
+ */
+void stopWorld() {
+    PTHREAD_MUTEX_LOCK(&cacheMutex);
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        PTHREAD_MUTEX_LOCK(&tc->mutex);
+    }
+}
+
+void resumeWorld() {
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+    }
+    PTHREAD_MUTEX_UNLOCK(&cacheMutex);
+}
+
+/**
+ * @brief Enters an accessor critical section. Accessors don't take any lock,
+ *        they only announce themselves so that compaction can wait for them to
+ *        leave before moving objects. While compaction is in progress
+ *        (odd compactEpoch) the accessor backs off and waits for it to finish.
+ *
+ * @return ThreadCache*: cache of the calling thread, to be passed to exitAccess
+ */
+ThreadCache* enterAccess() {
+    ThreadCache* tc = tcache != nullptr ? tcache : getThreadCache();
+    while (true) {
+        __atomic_store_n(&tc->inAccess, 1, __ATOMIC_SEQ_CST);
+        if ((__atomic_load_n(&compactEpoch, __ATOMIC_SEQ_CST) & 1) == 0) {
+            return tc;
+        }
+        __atomic_store_n(&tc->inAccess, 0, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&compactEpoch, __ATOMIC_ACQUIRE) & 1) {
+            sched_yield();
+        }
+    }
+}
+
+void exitAccess(ThreadCache* tc) {
+    __atomic_store_n(&tc->inAccess, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Starts a compaction epoch and waits until no thread is inside an accessor,
+ *        the world must be stopped
+ */
+void beginCompactEpoch() {
+    __atomic_add_fetch(&compactEpoch, 1, __ATOMIC_SEQ_CST);
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        while (__atomic_load_n(&tc->inAccess, __ATOMIC_SEQ_CST)) {
+            sched_yield();
+        }
+    }
+}
+
+void endCompactEpoch() {
+    __atomic_add_fetch(&compactEpoch, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Allocates heap-memory of given size
+ *
+ * @param size: size of the memory to be allocated
+ * @param gc: if true, garbage collector is created
+ * @param generational: if true, small objects are bump allocated from a nursery
+ *        and only promoted to the old generation after surviving PROMOTE_AGE minor collections
+ * @param compactThreads: number of threads a full compaction runs on
+ * @param maxSize: size the heap may grow to in chunks when it runs full, 0 to keep it at size
+ * @param pages: page size asked for, falls back to smaller pages if not available (see getPageMode())
+ */
+void createMem(int size, bool gc, bool generational, int compactThreads, int maxSize, PageMode pages) {
+    if (mem != nullptr)
+        throw std::runtime_error("Memory already created");
+    int bytes = size * EFFEC_MEM_RATIO;
+    int nurseryWords = generational ? (bytes >> 2) >> NURSERY_SHIFT : 0;
+    if (nurseryWords < (TLAB_MIN_WORDS << 3))
+        nurseryWords = 0;  // too small to hand out allocation buffers
+    int maxBytes = maxSize > size ? maxSize * EFFEC_MEM_RATIO - (nurseryWords << 3) : 0;
+    int symtable_size = min(SYM_SEGMENT_SIZE, (int)((max(size, maxSize) * EFFEC_MEM_RATIO) + 11) / 12);
+    initMem(bytes - (nurseryWords << 3), nurseryWords, maxBytes, symtable_size, pages);
+    startCollector(gc, compactThreads);
+}
+
+/**
+ * @brief Creates the heap, the symbol table and the nursery (if nurseryWords > 0),
+ *        the symbol table starts with symtable_size entries and grows up to one
+ *        entry per smallest block the reserved heap can hold
+ */
+void initMem(int heapBytes, int nurseryWords, int maxBytes, int symtable_size, PageMode pages) {
+    mem = new MemBlock();
+    mem->Init(heapBytes, nurseryWords << 3, maxBytes, pages);
+    symTable = new SymbolTable(symtable_size, (int)min((size_t)SYM_MAX_ENTRIES, mem->reserved / (MIN_BLOCK_WORDS << 2)));
+    tlabWords = min(TLAB_SIZE >> 2, (int)(mem->end - mem->start) >> 6);
+    if (nurseryWords > 0) {
+        tlabWords = min(TLAB_SIZE >> 2, nurseryWords >> 3);
+        nursery = new Nursery(mem->limit - mem->start, nurseryWords);
+    }
+    if (tlabWords < TLAB_MIN_WORDS)
+        tlabWords = 0;
+    symReserve = max(1, min(TLAB_SYMBOLS, symtable_size >> 6));
+    slabs = (mem->end - mem->start) >= (long)(SLAB_BYTES >> 2) * SLAB_MIN_HEAP;
+    for (int t = 0; t < SLAB_CLASSES; t++) {
+        slabClasses[t].init(t == Type::BOOL ? 1 : getSize((Type)t) << 3);
+    }
+    pacer.init((long long)(mem->end - mem->start) << 2);
+}
+
+/**
+ * @brief Starts the compaction threads and the garbage collector thread
+ */
+void startCollector(bool gc, int compactThreads) {
+    if (compactThreads > 1)
+        compactPool = new CompactPool(compactThreads);
+    string fname = gc ? "gc" : "non_gc";
+#ifdef GC_LOG
+    logfile = fopen((fname + ".csv").c_str(), "w");
+    fprintf(logfile, "%s\n", fname.c_str());
+#endif
+    if (gc) {
+        gcSched = new GcScheduler();
+        int ret = pthread_create(&gcThread, nullptr, garbageCollector, nullptr);
+        if (ret != 0) {
+            throw std::runtime_error("Error creating garbage collector thread");
+        }
+        LOG("createMem", _COLOR_BLUE, "Garbage collector thread created\n");
+        gc_active = true;
+    }
+}
+
+/**
+ * @brief Records the owner symbol in the footer of a nursery block,
+ *        blocks of the old generation keep their footer
+ */
+inline void setOwner(int wordid, int local_addr) {
+    if (nursery != nullptr && nursery->contains(wordid)) {
+        int* p = mem->start + wordid;
+        *(p + (*p >> 1) - 1) = local_addr << NURSERY_AGE_BITS;
+    }
+}
+
+/**
+ * @brief Allocates a block of given size and a symbol table entry pointing to it.
+ *        Small objects come from the calling thread's allocation buffer without
+ *        taking a global lock, which is only needed to refill the buffer.
+ *        Symbol table entries are reserved lock-free.
+ *
+ * @param size: size of the object in bytes
+ * @return int: index of the symbol table entry
+ */
+int allocObject(int size) {
+    ThreadCache* tc = getThreadCache();
+    int words = max(((size + 3) >> 2) + 2, MIN_BLOCK_WORDS);
+    bool small = words <= (tlabWords >> 3);
+    PTHREAD_MUTEX_LOCK(&tc->mutex);
+    if (tc->symCount == 0)
+        tc->symCount = symTable->reserve(symReserve, tc->symbols);
+    if (tc->symCount == 0) {
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        throw std::runtime_error("Out of memory in symbol table");
+    }
+    int wordid = small ? tc->bump(words) : -1;
+    if (wordid != -1) {
+        int local_addr = tc->symbols[--tc->symCount];
+        symTable->assign(local_addr, wordid, 0);
+        setOwner(wordid, local_addr);
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        return local_addr;
+    }
+    PTHREAD_MUTEX_UNLOCK(&tc->mutex);
     PTHREAD_MUTEX_LOCK(&mem->mutex);
+    if (small) {
+        PTHREAD_MUTEX_LOCK(&tc->mutex);
+        tc->refill();
+        wordid = tc->bump(words);
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        if (wordid == -1 && nursery != nullptr) {
+            // the nursery is full, evacuate it and try again
+            PTHREAD_MUTEX_LOCK(&symTable->mutex);
+            stopWorld();
+            minorCollect();
+            resumeWorld();
+            PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
+            PTHREAD_MUTEX_LOCK(&tc->mutex);
+            tc->refill();
+            wordid = tc->bump(words);
+            PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        }
+    }
+    if (wordid == -1) {
+        wordid = mem->getMem(size);
+    }
+    if (wordid == -1) {
+        // In case of out of memory, sweep the queued garbage and try again
+        PTHREAD_MUTEX_LOCK(&symTable->mutex);
+        stopWorld();
+        sweepQueued();
+        resumeWorld();
+        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
+        wordid = mem->getMem(size);
+    }
+    if (wordid == -1 && mem->totalFreeMem < words && mem->grow(words)) {
+        // mostly live data, growing is cheaper than compacting
+        pacer.resize((long long)(mem->end - mem->start) << 2);
+        wordid = mem->getMem(size);
+    }
+    if (wordid == -1) {
+        // compact the memory, then grow the heap, if that also fails, throw exception
+        PTHREAD_MUTEX_LOCK(&symTable->mutex);
+        stopWorld();
+        compactMem();
+        resumeWorld();
+        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
+        wordid = mem->getMem(size);
+        if (wordid == -1 && mem->grow(words)) {
+            pacer.resize((long long)(mem->end - mem->start) << 2);
+            wordid = mem->getMem(size);
+        }
+    }
+    if (wordid == -1) {
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        throw std::runtime_error("Out of memory");
+    }
+    if (!small)
+        pacerAlloc(*(mem->start + wordid) >> 1);
+    PTHREAD_MUTEX_LOCK(&tc->mutex);
+    int local_addr = tc->symbols[--tc->symCount];
+    symTable->assign(local_addr, wordid, 0);
+    setOwner(wordid, local_addr);
+    PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    return local_addr;
+}
+
+/**
+ * @brief Sets up a slab class of slots of bits bits: as many slots as fit in
+ *        SLAB_BYTES with the header and the occupancy bitmap
+ */
+void SlabClass::init(int bits) {
+    int words = (SLAB_BYTES >> 2) - SLAB_HEADER_WORDS;
+    slotBits = bits;
+    slots = (words << 5) / (bits + 1);
+    while (((slots + 31) >> 5) + ((slots * bits + 31) >> 5) > words) {
+        slots--;
+    }
+    bitmapWords = (slots + 31) >> 5;
+    partial.clear();
+}
+
+/**
+ * @brief Allocates a slab for scalars of type t and puts it on the partial list
+ */
+void newSlab(const Type& t) {
+    SlabClass& c = slabClasses[t];
+    int slab = allocObject(SLAB_BYTES);
+    ThreadCache* tc = getThreadCache();
+    PTHREAD_MUTEX_LOCK(&tc->mutex);  // blocks don't move while it is held
+    int* s = symTable->getPtr(slab);
+    s[SLAB_TYPE] = t;
+    s[SLAB_USED] = 0;
+    s[SLAB_HINT] = 0;
+    memset(s + SLAB_HEADER_WORDS, 0, c.bitmapWords << 2);
+    PTHREAD_MUTEX_LOCK(&slabMutex);
+    s[SLAB_POS] = c.partial.size();
+    c.partial.push_back(slab);
+    PTHREAD_MUTEX_UNLOCK(&slabMutex);
+    PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+    LOG("newSlab", _COLOR_BLUE, "Created slab %d of %d slots\n", slab, c.slots);
+}
+
+/**
+ * @brief Takes the slab at s (owned by symbol slab) off the partial list of its class,
+ *        slabMutex must be held
+ */
+void removePartial(SlabClass& c, int* s) {
+    int pos = s[SLAB_POS];
+    int last = c.partial.back();
+    c.partial[pos] = last;
+    symTable->getPtr(last)[SLAB_POS] = pos;
+    c.partial.pop_back();
+    s[SLAB_POS] = -1;
+}
+
+/**
+ * @brief Allocates a slot for a scalar of type t and a symbol table entry pointing
+ *        to it, a new slab is allocated when no slab of the type has a free slot
+ *
+ * @return int: index of the symbol table entry
+ */
+int allocSlot(const Type& t) {
+    SlabClass& c = slabClasses[t];
+    ThreadCache* tc = getThreadCache();
+    while (true) {
+        PTHREAD_MUTEX_LOCK(&tc->mutex);
+        if (tc->symCount == 0)
+            tc->symCount = symTable->reserve(symReserve, tc->symbols);
+        if (tc->symCount == 0) {
+            PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+            throw std::runtime_error("Out of memory in symbol table");
+        }
+        PTHREAD_MUTEX_LOCK(&slabMutex);
+        if (!c.partial.empty()) {
+            int slab = c.partial.back();
+            int* s = symTable->getPtr(slab);
+            unsigned int* bitmap = (unsigned int*)(s + SLAB_HEADER_WORDS);
+            int w = s[SLAB_HINT];
+            while (bitmap[w] == ~0u) {
+                w++;
+            }
+            int slot = (w << 5) + __builtin_ctz(~bitmap[w]);
+            bitmap[w] |= 1u << (slot & 31);
+            s[SLAB_HINT] = w;
+            if (++s[SLAB_USED] == c.slots)
+                removePartial(c, s);
+            PTHREAD_MUTEX_UNLOCK(&slabMutex);
+            int local_addr = tc->symbols[--tc->symCount];
+            symTable->assignSlot(local_addr, slab, c.slotOffset(slot));
+            PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+            return local_addr;
+        }
+        PTHREAD_MUTEX_UNLOCK(&slabMutex);
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        newSlab(t);
+    }
+}
+
+/**
+ * @brief Frees the slot of a scalar and its symbol, the slab is freed once it is
+ *        empty unless it is the last partial slab of its class. mem->mutex must be held.
+ */
+void freeSlot(int local_addr) {
+    int slab = symTable->getSlab(local_addr);
+    int* s = symTable->getPtr(slab);
+    SlabClass& c = slabClasses[s[SLAB_TYPE]];
+    int slot = c.slotOf(symTable->getOffset(local_addr));
+    symTable->free(local_addr);
+    bool empty = false;
+    PTHREAD_MUTEX_LOCK(&slabMutex);
+    ((unsigned int*)(s + SLAB_HEADER_WORDS))[slot >> 5] &= ~(1u << (slot & 31));
+    s[SLAB_HINT] = min(s[SLAB_HINT], slot >> 5);
+    int used = --s[SLAB_USED];
+    if (used == c.slots - 1) {
+        s[SLAB_POS] = c.partial.size();
+        c.partial.push_back(slab);
+    } else if (used == 0 && c.partial.size() > 1) {
+        removePartial(c, s);
+        empty = true;
+    }
+    PTHREAD_MUTEX_UNLOCK(&slabMutex);
+    if (empty) {
+        LOG("freeSlot", _COLOR_BLUE, "Freeing empty slab %d\n", slab);
+        _freeElem(slab);
+    }
+}
+
+/**
+ * @brief Reads the scalar in the slot of symbol idx, medium ints are sign extended
+ */
+inline int loadScalar(int idx) {
+    int* base = mem->start + symTable->getWordIdx(idx) + 1;
+    int offset = symTable->getOffset(idx);
+    switch (base[SLAB_TYPE]) {
+        case Type::BOOL:
+            return (__atomic_load_n(base + (offset >> 5), __ATOMIC_RELAXED) >> (offset & 31)) & 1;
+        case Type::CHAR:
+            return *((char*)base + offset);
+        case Type::MEDIUM_INT:
+            return loadMedium((char*)base + offset);
+        default: {
+            int val;
+            memcpy(&val, (char*)base + offset, 4);
+            return val;
+        }
+    }
+}
+
+/**
+ * @brief Writes val to the slot of symbol idx, only the bytes (or the bit) of the
+ *        slot are written since neighbouring slots may be written concurrently
+ */
+inline void storeScalar(int idx, int val) {
+    int* base = mem->start + symTable->getWordIdx(idx) + 1;
+    int offset = symTable->getOffset(idx);
+    switch (base[SLAB_TYPE]) {
+        case Type::BOOL:
+            if (val)
+                __atomic_fetch_or(base + (offset >> 5), 1 << (offset & 31), __ATOMIC_RELAXED);
+            else
+                __atomic_fetch_and(base + (offset >> 5), ~(1 << (offset & 31)), __ATOMIC_RELAXED);
+            break;
+        case Type::CHAR:
+            *((char*)base + offset) = val;
+            break;
+        case Type::MEDIUM_INT:
+            storeMedium((char*)base + offset, val);
+            break;
+        default:
+            memcpy((char*)base + offset, &val, 4);
+    }
+}
+
+/**
+ * @brief Bytes of heap taken by the object of symbol idx, a slot counts its own
+ *        bytes only. The object must not move while called.
+ */
+long long objectBytes(int idx) {
+    if (symTable->isSlot(idx)) {
+        int* s = symTable->getPtr(symTable->getSlab(idx));
+        return (slabClasses[s[SLAB_TYPE]].slotBits + 7) >> 3;
+    }
+    return (long long)(*(mem->start + symTable->getWordIdx(idx)) >> 1) << 2;
+}
+
+/**
+ * @brief Create an object of given Type t and returns a Ptr struct object
+ *
+ * @param t: type of the object to be created
+ * @return Ptr: Ptr to the created object
+ */
+Ptr createVar(const Type& t) {
+    int local_addr;
+    if (slabs && t != Type::ARRAY) {
+        local_addr = allocSlot(t);  // scalars are packed in slabs
+    } else {
+        local_addr = allocObject(((getSize(t) + 3) >> 2) << 2);
+    }
+    LOG("createVar", _COLOR_BLUE, "Created variable at local address: %d\n", translate2La(local_addr));
+    Handle h = symTable->handle(local_addr);
+    tcache->stack->push(h);
+    return Ptr(t, h);
+}
+
+/**
+ * @brief Returns the payload size in bytes (whole words) of an array of base type t
+ *
+ * @param t: Base type of the array
+ * @param width: size of the array
+ * @return int: size in bytes
+ */
+int arrayBytes(const Type& t, int width) {
+    if (t == Type::MEDIUM_INT) {
+        return (int)((((long long)width * 3 + 3) >> 2) << 2);  // packed 3 bytes to an element
+    }
+    int wordsize = t == Type::BOOL ? 32 : 4;
+    int _count = wordsize / getSize(t);
+    int _width = (width + _count - 1) / _count;  // round up
+    return _width << 2;
+}
+
+/**
+ * @brief Creates an array object of baseType t and size: width and returns a Ptr struct object
+ *
+ * @param t: Base type of the array
+ * @param width: size of the array
+ * @return ArrPtr: Ptr to the created array
+ */
+ArrPtr createArr(const Type& t, int width) {
+    int _size = arrayBytes(t, width);
+    int local_addr = allocObject(_size);
+    LOG("createArr", _COLOR_BLUE, "Created array at local address: %d\n", translate2La(local_addr));
+    Handle h = symTable->handle(local_addr);
+    tcache->stack->push(h);
+    return ArrPtr(t, h, width);
+}
+
+/**
+ * @brief Get the value of the object pointed by the Ptr and stores it in val
+ *
+ * @param[in] p: Ptr to the object
+ * @param[out] val: storing the value of the object
+ */
+void getVar(const Ptr& p, void* val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    ThreadCache* tc = enterAccess();
+    if (symTable->isSlot(local_addr)) {
+        int temp = loadScalar(local_addr);
+        memcpy(val, &temp, getSize(p.type));
+        exitAccess(tc);
+        return;
+    }
     int* ptr = symTable->getPtr(local_addr);
     int temp = *(int*)ptr;
     LOG("getVar", _COLOR_BLUE, "Copying 4 bytes from memory at logical address: %ld\n", (ptr - mem->start) << 2);
@@ -445,470 +1597,2281 @@ void getVar(const Ptr& p, void* val) {
         }
     }
     memcpy(val, &temp, getSize(p.type));
+    exitAccess(tc);
+}
+
+/**
+ * @brief Get the value of the array pointed by the ArrPtr and stores it in val
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index of the array
+ * @param val: storing the value of the array
+ */
+void getVar(const ArrPtr& p, int idx, void* val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (idx < 0 || idx >= p.width)
+        throw std::runtime_error("Index out of bounds");
+    ThreadCache* tc = enterAccess();
+    int* ptr = symTable->getPtr(local_addr);
+    int word = getWordForIdx(p.type, idx);
+    int offset = getOffsetForIdx(p.type, idx);
+    ptr = ptr + word;
+    int temp = *ptr;
+    LOG("getVar", _COLOR_BLUE, "Copying 4 bytes from memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    if (p.type == Type::BOOL) {
+        bool b = temp & (1 << offset);
+        memcpy(val, &b, 1);
+    } else if (p.type == Type::MEDIUM_INT)
+        memcpy(val, (char*)ptr + offset, 3);  // the element may span two words
+    else
+        memcpy(val, (char*)&temp + offset, getSize(p.type));
+    exitAccess(tc);
+}
+
+/**
+ * @brief Validates a range [start, start + count) of an array of base type t
+ *
+ * @return int: symbol of the array
+ */
+int checkArrRange(const ArrPtr& p, const Type& t, int start, int count) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != t)
+        throw std::runtime_error("Array type mismatch");
+    if (start < 0 || count < 0 || (long long)start + count > p.width)
+        throw std::runtime_error("Index out of bounds");
+    return local_addr;
+}
+
+/**
+ * @brief Validates a range [start, start + count) of an array of base type t and
+ *        enters the accessor section, the caller must call exitAccess(tc)
+ *
+ * @param p: ArrPtr to the array
+ * @param t: expected base type of the array
+ * @param start: first index of the range
+ * @param count: number of elements in the range
+ * @param[out] tc: cache of the calling thread
+ * @return int*: pointer to the first word of the array
+ */
+int* enterArrRange(const ArrPtr& p, const Type& t, int start, int count, ThreadCache*& tc) {
+    int local_addr = checkArrRange(p, t, start, count);
+    tc = enterAccess();
+    return symTable->getPtr(local_addr);
+}
+
+/**
+ * @brief Copies elements [start, start + count) of an int or medium int array
+ *        into out, medium ints are sign extended
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param count: number of elements to read
+ * @param[out] out: caller buffer of at least count elements
+ */
+void getArr(const ArrPtr& p, int start, int count, int out[]) {
+    ThreadCache* tc;
+    if (p.type == Type::MEDIUM_INT) {
+        int* ptr = enterArrRange(p, Type::MEDIUM_INT, start, count, tc);
+        unpackMedium(out, (medium_int*)ptr + start, count);
+    } else {
+        int* ptr = enterArrRange(p, Type::INT, start, count, tc);
+        memcpy(out, ptr + start, (size_t)count << 2);
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Copies elements [start, start + count) of a medium int array into out,
+ *        elements are packed 3 bytes apiece so this is a plain byte copy
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param count: number of elements to read
+ * @param[out] out: caller buffer of at least count elements
+ */
+void getArr(const ArrPtr& p, int start, int count, medium_int out[]) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::MEDIUM_INT, start, count, tc);
+    memcpy((void*)out, (char*)ptr + (size_t)start * 3, (size_t)count * 3);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Copies elements [start, start + count) of a char array into out,
+ *        chars are packed 4 to a word so the range is contiguous bytes
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param count: number of elements to read
+ * @param[out] out: caller buffer of at least count elements
+ */
+void getArr(const ArrPtr& p, int start, int count, char out[]) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::CHAR, start, count, tc);
+    memcpy(out, (char*)ptr + start, count);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Expands the 8 bits of b into 8 bytes of 0/1 (bit j to byte j)
+ */
+inline unsigned long long expandBits(unsigned int b) {
+    unsigned long long x = (b * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+    return ((x + 0x7f7f7f7f7f7f7f7fULL) >> 7) & 0x0101010101010101ULL;
+}
+
+/**
+ * @brief Copies elements [start, start + count) of a bool array into out,
+ *        bools are packed 32 to a word, whole bytes are expanded at a time
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param count: number of elements to read
+ * @param[out] out: caller buffer of at least count elements
+ */
+void getArr(const ArrPtr& p, int start, int count, bool out[]) {
+    ThreadCache* tc;
+    unsigned char* bits = (unsigned char*)enterArrRange(p, Type::BOOL, start, count, tc);
+    int i = 0;
+    for (; i < count && ((start + i) & 7); i++) {
+        out[i] = (bits[(start + i) >> 3] >> ((start + i) & 7)) & 1;
+    }
+    for (; i + 8 <= count; i += 8) {
+        unsigned long long x = expandBits(bits[(start + i) >> 3]);
+        memcpy(out + i, &x, 8);
+    }
+    for (; i < count; i++) {
+        out[i] = (bits[(start + i) >> 3] >> ((start + i) & 7)) & 1;
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Pins the array, a pinned array is neither moved by compaction nor
+ *        collected until it is unpinned. Arrays in the nursery are moved to the
+ *        old generation first since every minor collection moves them.
+ *
+ * @param p: ArrPtr to the array
+ * @param t: expected base type of the array
+ * @return int*: pointer to the first word of the array
+ */
+int* pinArrRange(const ArrPtr& p, const Type& t) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, t, 0, 0, tc);
+    int local_addr = HANDLE_IDX(p.addr);  // checked by enterArrRange
+    if (nursery == nullptr || !nursery->contains(symTable->getWordIdx(local_addr))) {
+        symTable->pin(local_addr);
+        exitAccess(tc);
+        return ptr;
+    }
+    exitAccess(tc);
+    PTHREAD_MUTEX_LOCK(&mem->mutex);
+    PTHREAD_MUTEX_LOCK(&symTable->mutex);
+    stopWorld();
+    beginCompactEpoch();
+    int wordid = -1;
+    bool alive = symTable->lookup(p.addr) != -1 && symTable->isAllocated(local_addr);
+    if (alive) {
+        wordid = symTable->getWordIdx(local_addr);
+        if (nursery->contains(wordid))
+            wordid = promote(mem->start + wordid, local_addr);
+        if (wordid != -1)
+            symTable->pin(local_addr);
+    }
+    endCompactEpoch();
+    resumeWorld();
+    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
     PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    if (!alive)
+        throw std::runtime_error("Variable not in symbol table");
+    if (wordid == -1)
+        throw std::runtime_error("Out of memory");
+    return mem->start + wordid + 1;
+}
+
+/**
+ * @brief Pins an int array and returns a view of its payload
+ *
+ * @param p: ArrPtr to the array
+ * @param[out] v: view of the array, valid until unpinArr(p)
+ */
+void pinArr(const ArrPtr& p, ArrView<int>& v) {
+    int* ptr = pinArrRange(p, Type::INT);
+    v = ArrView<int>(ptr, p.width);
+}
+
+/**
+ * @brief Pins a medium int array and returns a view of its payload, elements
+ *        are packed 3 bytes apiece
+ *
+ * @param p: ArrPtr to the array
+ * @param[out] v: view of the array, valid until unpinArr(p)
+ */
+void pinArr(const ArrPtr& p, ArrView<medium_int>& v) {
+    medium_int* ptr = (medium_int*)pinArrRange(p, Type::MEDIUM_INT);
+    v = ArrView<medium_int>(ptr, p.width);
+}
+
+/**
+ * @brief Pins a char array and returns a view of its payload
+ *
+ * @param p: ArrPtr to the array
+ * @param[out] v: view of the array, valid until unpinArr(p)
+ */
+void pinArr(const ArrPtr& p, ArrView<char>& v) {
+    char* ptr = (char*)pinArrRange(p, Type::CHAR);
+    v = ArrView<char>(ptr, p.width);
+}
+
+/**
+ * @brief Pins a bool array and returns a view of its payload, bool i is
+ *        bit i % 32 of word i / 32
+ *
+ * @param p: ArrPtr to the array
+ * @param[out] v: view of the packed words of the array, valid until unpinArr(p)
+ */
+void pinArr(const ArrPtr& p, ArrView<unsigned int>& v) {
+    unsigned int* ptr = (unsigned int*)pinArrRange(p, Type::BOOL);
+    v = ArrView<unsigned int>(ptr, (p.width + 31) >> 5);
+}
+
+/**
+ * @brief Drops one pin of the array, views taken by pinArr must not be used
+ *        after the last pin is dropped
+ *
+ * @param p: ArrPtr to the array
+ */
+void unpinArr(const ArrPtr& p) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !symTable->isAllocated(local_addr))
+        throw std::runtime_error("Variable not in symbol table");
+    if (!symTable->unpin(local_addr))
+        throw std::runtime_error("Array is not pinned");
+    if (!symTable->isPinned(local_addr) && !symTable->isMarked(local_addr)) {
+        // went out of scope while pinned, the sweep skipped it
+        ThreadCache* tc = getThreadCache();
+        PTHREAD_MUTEX_LOCK(&tc->mutex);
+        tc->garbage.push_back(local_addr);
+        __atomic_add_fetch(&pendingGarbage, 1, __ATOMIC_RELAXED);
+        PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+        gcNotify();
+    }
+}
+
+/**
+ * @brief Assign the value of val to the object pointed by the Ptr
+ *
+ * @param p: Ptr to the object
+ * @param val: value to be assigned
+ */
+void assignVar(const Ptr& p, int val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::INT)
+        throw std::runtime_error("Assignment to non-int variable");
+    ThreadCache* tc = enterAccess();
+    if (symTable->isSlot(local_addr)) {
+        storeScalar(local_addr, val);
+        exitAccess(tc);
+        return;
+    }
+    int* ptr = symTable->getPtr(local_addr);
+    memcpy((void*)ptr, &val, 4);
+    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to the object pointed by the Ptr
+ *
+ * @param p: Ptr to the object
+ * @param val: value to be assigned
+ */
+void assignVar(const Ptr& p, medium_int val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::MEDIUM_INT)
+        throw std::runtime_error("Assignment to non-int variable");
+    ThreadCache* tc = enterAccess();
+    int temp = val.to_int();
+    if (symTable->isSlot(local_addr)) {
+        storeScalar(local_addr, temp);
+        exitAccess(tc);
+        return;
+    }
+    int* ptr = symTable->getPtr(local_addr);
+    memcpy((void*)ptr, &temp, 4);
+    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to the object pointed by the Ptr
+ *
+ * @param p: Ptr to the object
+ * @param val: value to be assigned
+ */
+void assignVar(const Ptr& p, bool f) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::BOOL)
+        throw std::runtime_error("Assignment to non-bool variable");
+    ThreadCache* tc = enterAccess();
+    int temp = f ? 1 : 0;
+    if (symTable->isSlot(local_addr)) {
+        storeScalar(local_addr, temp);
+        exitAccess(tc);
+        return;
+    }
+    int* ptr = symTable->getPtr(local_addr);
+    memcpy((void*)ptr, &temp, 4);
+    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to the object pointed by the Ptr
+ *
+ * @param p: Ptr to the object
+ * @param val: value to be assigned
+ */
+void assignVar(const Ptr& p, char c) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::CHAR)
+        throw std::runtime_error("Assignment to non-char variable");
+    ThreadCache* tc = enterAccess();
+    int temp = c;
+    if (symTable->isSlot(local_addr)) {
+        storeScalar(local_addr, temp);
+        exitAccess(tc);
+        return;
+    }
+    int* ptr = symTable->getPtr(local_addr);
+    memcpy((void*)ptr, &temp, 4);
+    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to an index of the array pointed by the ArrPtr
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index of the array
+ * @param val: value to be assigned
+ */
+void assignArr(const ArrPtr& p, int idx, int val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::INT)
+        throw std::runtime_error("Assignment to non-int array");
+    ThreadCache* tc = enterAccess();
+    int* ptr = symTable->getPtr(local_addr);
+    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    int word = getWordForIdx(p.type, idx);
+    int offset = getOffsetForIdx(p.type, idx);
+    ptr = (int*)((char*)ptr + word * 4 + offset);
+    memcpy((void*)ptr, &val, 4);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to an index of the array pointed by the ArrPtr
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index of the array
+ * @param val: value to be assigned
+ */
+void assignArr(const ArrPtr& p, int idx, medium_int val) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::MEDIUM_INT)
+        throw std::runtime_error("Assignment to non-medium-int array");
+    ThreadCache* tc = enterAccess();
+    int* ptr = symTable->getPtr(local_addr);
+    LOG("assignArr", _COLOR_BLUE, "Assigned 3 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    int word = getWordForIdx(p.type, idx);
+    int offset = getOffsetForIdx(p.type, idx);
+    storeMedium((char*)(ptr + word) + offset, val.to_int());  // neighbouring elements are untouched
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to an index of the array pointed by the ArrPtr
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index of the array
+ * @param val: value to be assigned
+ */
+void assignArr(const ArrPtr& p, int idx, char c) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::CHAR)
+        throw std::runtime_error("Assignment to non-char array");
+    ThreadCache* tc = enterAccess();
+    int* ptr = symTable->getPtr(local_addr);
+    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    int word = getWordForIdx(p.type, idx);
+    int offset = getOffsetForIdx(p.type, idx);
+    *((char*)(ptr + word) + offset) = c;  // byte store, neighbours in the word are untouched
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign the value of val to an index of the array pointed by the ArrPtr
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index of the array
+ * @param val: value to be assigned
+ */
+void assignArr(const ArrPtr& p, int idx, bool f) {
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+        throw std::runtime_error("Variable not in symbol table");
+    if (p.type != Type::BOOL)
+        throw std::runtime_error("Assignment to non-bool array");
+    ThreadCache* tc = enterAccess();
+    int* ptr = symTable->getPtr(local_addr);
+    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    int word = getWordForIdx(p.type, idx);
+    int offset = getOffsetForIdx(p.type, idx);
+    ptr = ptr + word;
+    // other bits of the word may be written concurrently without a lock
+    if (f)
+        __atomic_fetch_or(ptr, 1 << offset, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_and(ptr, ~(1 << offset), __ATOMIC_RELAXED);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign values of arr from 0 to n-1, to the int or medium int array pointed
+ *        by the ArrPtr, values stored to a medium int array keep their low 3 bytes
+ *
+ * @param p: ArrPtr to the array
+ * @param arr: array of values to be assigned
+ * @param n: size of the array
+ */
+void assignArr(const ArrPtr& p, int arr[], int n) {
+    ThreadCache* tc;
+    if (p.type == Type::MEDIUM_INT) {
+        int* ptr = enterArrRange(p, Type::MEDIUM_INT, 0, n, tc);
+        packMedium((medium_int*)ptr, arr, n);
+    } else {
+        int* ptr = enterArrRange(p, Type::INT, 0, n, tc);
+        memcpy(ptr, arr, (size_t)n << 2);
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr,
+ *        elements are packed 3 bytes apiece so this is a plain byte copy
+ *
+ * @param p: ArrPtr to the array
+ * @param arr: array of values to be assigned
+ * @param n: size of the array
+ */
+void assignArr(const ArrPtr& p, medium_int arr[], int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::MEDIUM_INT, 0, n, tc);
+    memcpy(ptr, arr, (size_t)n * 3);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr,
+ *        chars are packed 4 to a word so this is a plain byte copy
+ *
+ * @param p: ArrPtr to the array
+ * @param arr: array of values to be assigned
+ * @param n: size of the array
+ */
+void assignArr(const ArrPtr& p, char arr[], int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::CHAR, 0, n, tc);
+    memcpy(ptr, arr, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr,
+ *        bools are packed 32 to a word
+ *
+ * @param p: ArrPtr to the array
+ * @param arr: array of values to be assigned
+ * @param n: size of the array
+ */
+void assignArr(const ArrPtr& p, bool arr[], int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::BOOL, 0, n, tc);
+    packBits(ptr, 0, arr, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets elements [start, start + n) of an int array to val
+ *
+ * @param p: ArrPtr to the array
+ * @param val: value to be assigned
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void fillArr(const ArrPtr& p, int val, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::INT, start, n, tc);
+    fillWords(ptr + start, val, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets elements [start, start + n) of a medium int array to val
+ *
+ * @param p: ArrPtr to the array
+ * @param val: value to be assigned
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void fillArr(const ArrPtr& p, medium_int val, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::MEDIUM_INT, start, n, tc);
+    fillMedium((medium_int*)ptr + start, val.to_int(), n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets elements [start, start + n) of a char array to c
+ *
+ * @param p: ArrPtr to the array
+ * @param c: value to be assigned
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void fillArr(const ArrPtr& p, char c, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::CHAR, start, n, tc);
+    memset((char*)ptr + start, c, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets elements [start, start + n) of a bool array to f
+ *
+ * @param p: ArrPtr to the array
+ * @param f: value to be assigned
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void fillArr(const ArrPtr& p, bool f, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::BOOL, start, n, tc);
+    fillBits(ptr, start, n, f);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets element start + i of an int array to val + i, for i in [0, n)
+ *
+ * @param p: ArrPtr to the array
+ * @param val: value of the first element
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void iotaArr(const ArrPtr& p, int val, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::INT, start, n, tc);
+    iotaWords(ptr + start, val, n, 0);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets element start + i of a medium int array to val + i, for i in [0, n),
+ *        values wrap around at 24 bits like medium_int arithmetic
+ *
+ * @param p: ArrPtr to the array
+ * @param val: value of the first element
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void iotaArr(const ArrPtr& p, medium_int val, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::MEDIUM_INT, start, n, tc);
+    medium_int* dst = (medium_int*)ptr + start;
+    int buf[256];  // generated as words, then packed
+    for (int i = 0; i < n; i += 256) {
+        int k = min(256, n - i);
+        iotaWords(buf, (int)((unsigned int)val.to_int() + i), k, 0);
+        packMedium(dst + i, buf, k);
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets element start + i of a char array to c + i, for i in [0, n)
+ *
+ * @param p: ArrPtr to the array
+ * @param c: value of the first element
+ * @param start: first index to write
+ * @param n: number of elements to write
+ */
+void iotaArr(const ArrPtr& p, char c, int start, int n) {
+    ThreadCache* tc;
+    char* ptr = (char*)enterArrRange(p, Type::CHAR, start, n, tc) + start;
+    for (int i = 0; i < n; i++) {
+        ptr[i] = (char)(c + i);
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sum of elements [start, start + n) of an array, computed over the packed
+ *        payload in a single accessor section (a bool array sums to its set bits)
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param n: number of elements to read
+ * @return long long: sum of the elements
+ */
+long long sumArr(const ArrPtr& p, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, p.type, start, n, tc);
+    long long sum;
+    switch (p.type) {
+        case Type::INT:
+            sum = sumWords(ptr + start, n);
+            break;
+        case Type::MEDIUM_INT:
+            sum = sumMedium((medium_int*)ptr + start, n);
+            break;
+        case Type::CHAR:
+            sum = sumChars((char*)ptr + start, n);
+            break;
+        default:
+            sum = countBits(ptr, start, n);
+    }
+    exitAccess(tc);
+    return sum;
+}
+
+/**
+ * @brief Minimum and maximum of elements [start, start + n) of an array
+ */
+static void minMaxArr(const ArrPtr& p, int start, int n, int& mn, int& mx) {
+    if (n == 0)
+        throw std::runtime_error("Empty range");
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, p.type, start, n, tc);
+    mn = INT_MAX;
+    mx = INT_MIN;
+    switch (p.type) {
+        case Type::INT:
+            minMaxWords(ptr + start, n, mn, mx);
+            break;
+        case Type::MEDIUM_INT:
+            minMaxMedium((medium_int*)ptr + start, n, mn, mx);
+            break;
+        case Type::CHAR:
+            minMaxChars((char*)ptr + start, n, mn, mx);
+            break;
+        default: {
+            int ones = countBits(ptr, start, n);
+            mn = ones == n;
+            mx = ones > 0;
+        }
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Minimum of elements [start, start + n) of an array, n must be positive
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param n: number of elements to read
+ * @return int: smallest element, sign extended
+ */
+int minArr(const ArrPtr& p, int start, int n) {
+    int mn, mx;
+    minMaxArr(p, start, n, mn, mx);
+    return mn;
+}
+
+/**
+ * @brief Maximum of elements [start, start + n) of an array, n must be positive
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param n: number of elements to read
+ * @return int: largest element, sign extended
+ */
+int maxArr(const ArrPtr& p, int start, int n) {
+    int mn, mx;
+    minMaxArr(p, start, n, mn, mx);
+    return mx;
+}
+
+/**
+ * @brief Number of elements in [start, start + n) of an array equal to val,
+ *        elements are compared sign extended (bools as 0 and 1)
+ *
+ * @param p: ArrPtr to the array
+ * @param val: value to count
+ * @param start: first index to read
+ * @param n: number of elements to read
+ * @return int: number of matching elements
+ */
+int countEqArr(const ArrPtr& p, int val, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, p.type, start, n, tc);
+    int cnt;
+    switch (p.type) {
+        case Type::INT:
+            cnt = countEqWords(ptr + start, n, val);
+            break;
+        case Type::MEDIUM_INT:
+            cnt = countEqMedium((medium_int*)ptr + start, n, val);
+            break;
+        case Type::CHAR:
+            cnt = val == (char)val ? countEqChars((char*)ptr + start, n, (char)val) : 0;
+            break;
+        default: {
+            int ones = countBits(ptr, start, n);
+            cnt = val == 1 ? ones : val == 0 ? n - ones : 0;
+        }
+    }
+    exitAccess(tc);
+    return cnt;
+}
+
+/**
+ * @brief Number of set bits in [start, start + n) of a bool array, counted a
+ *        word at a time over the packed bits
+ *
+ * @param p: ArrPtr to the array
+ * @param start: first index to read
+ * @param n: number of elements to read
+ * @return int: number of true elements
+ */
+int popcountArr(const ArrPtr& p, int start, int n) {
+    ThreadCache* tc;
+    int* ptr = enterArrRange(p, Type::BOOL, start, n, tc);
+    int cnt = countBits(ptr, start, n);
+    exitAccess(tc);
+    return cnt;
+}
+
+/**
+ * @brief Validates the range [start, start + n) of the arrays dst, a and b (if not
+ *        null) of base type t and enters the accessor section, the caller must call
+ *        exitAccess(tc)
+ *
+ * @param[out] ptrs: first word of dst, a and b
+ * @param[out] tc: cache of the calling thread
+ */
+static void enterArrays(const Type& t, const ArrPtr& dst, const ArrPtr& a, const ArrPtr* b, int start, int n, int* ptrs[3], ThreadCache*& tc) {
+    int d = checkArrRange(dst, t, start, n);
+    int x = checkArrRange(a, t, start, n);
+    int y = b != nullptr ? checkArrRange(*b, t, start, n) : -1;
+    tc = enterAccess();
+    ptrs[0] = symTable->getPtr(d);
+    ptrs[1] = symTable->getPtr(x);
+    ptrs[2] = y != -1 ? symTable->getPtr(y) : nullptr;
+}
+
+/**
+ * @brief enterArrays() for int or medium int arrays
+ */
+static void enterArithmetic(const ArrPtr& dst, const ArrPtr& a, const ArrPtr* b, int start, int n, int* ptrs[3], ThreadCache*& tc) {
+    if (dst.type != Type::INT && dst.type != Type::MEDIUM_INT)
+        throw std::runtime_error("Arithmetic on non-int array");
+    enterArrays(dst.type, dst, a, b, start, n, ptrs, tc);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] + k * b[i] for i in [start, start + n)
+ */
+static void addScaledArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int k, int start, int n) {
+    int* ptrs[3];
+    ThreadCache* tc;
+    enterArithmetic(dst, a, &b, start, n, ptrs, tc);
+    if (dst.type == Type::MEDIUM_INT)
+        addMedium((medium_int*)ptrs[0] + start, (medium_int*)ptrs[1] + start, (medium_int*)ptrs[2] + start, k, n);
+    else
+        addWords(ptrs[0] + start, ptrs[1] + start, ptrs[2] + start, k, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] + b[i] for i in [start, start + n), the arrays are int or
+ *        medium int arrays of one type and results wrap around like the scalar types
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void addArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    addScaledArr(dst, a, b, 1, start, n);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] - b[i] for i in [start, start + n), the arrays are int or
+ *        medium int arrays of one type and results wrap around like the scalar types
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void subArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    addScaledArr(dst, a, b, -1, start, n);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * b[i] for i in [start, start + n), the arrays are int or
+ *        medium int arrays of one type and results wrap around like the scalar types
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void mulArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    int* ptrs[3];
+    ThreadCache* tc;
+    enterArithmetic(dst, a, &b, start, n, ptrs, tc);
+    if (dst.type == Type::MEDIUM_INT)
+        mulMedium((medium_int*)ptrs[0] + start, (medium_int*)ptrs[1] + start, (medium_int*)ptrs[2] + start, n);
+    else
+        mulWords(ptrs[0] + start, ptrs[1] + start, ptrs[2] + start, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * k for i in [start, start + n), the arrays are int or
+ *        medium int arrays of one type and results wrap around like the scalar types
+ *
+ * @param dst: ArrPtr to the result array, may be a
+ * @param a: ArrPtr to the operand
+ * @param k: scale factor
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void scaleArr(const ArrPtr& dst, const ArrPtr& a, int k, int start, int n) {
+    int* ptrs[3];
+    ThreadCache* tc;
+    enterArithmetic(dst, a, nullptr, start, n, ptrs, tc);
+    if (dst.type == Type::MEDIUM_INT)
+        scaleMedium((medium_int*)ptrs[0] + start, (medium_int*)ptrs[1] + start, k, n);
+    else
+        scaleWords(ptrs[0] + start, ptrs[1] + start, k, n);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets y[i] to y[i] + alpha * x[i] for i in [start, start + n), the arrays are int
+ *        or medium int arrays of one type and results wrap around like the scalar types
+ *
+ * @param y: ArrPtr to the accumulated array
+ * @param alpha: scale factor of x
+ * @param x: ArrPtr to the scaled operand, may be y
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void axpyArr(const ArrPtr& y, int alpha, const ArrPtr& x, int start, int n) {
+    addScaledArr(y, y, x, alpha, start, n);
+}
+
+/**
+ * @brief Sets the bits [start, start + n) of the bool array dst to a op b
+ */
+static void bitOpArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr* b, int start, int n, BitOp op) {
+    int* ptrs[3];
+    ThreadCache* tc;
+    enterArrays(Type::BOOL, dst, a, b, start, n, ptrs, tc);
+    bitOpBits(ptrs[0], ptrs[1], ptrs[2], start, n, op);
+    exitAccess(tc);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] && b[i] for i in [start, start + n) of bool arrays,
+ *        a word (32 elements) at a time
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void andArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    bitOpArr(dst, a, &b, start, n, BIT_AND);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] || b[i] for i in [start, start + n) of bool arrays,
+ *        a word (32 elements) at a time
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void orArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    bitOpArr(dst, a, &b, start, n, BIT_OR);
+}
+
+/**
+ * @brief Sets dst[i] to a[i] != b[i] for i in [start, start + n) of bool arrays,
+ *        a word (32 elements) at a time
+ *
+ * @param dst: ArrPtr to the result array, may be a or b
+ * @param a: ArrPtr to the first operand
+ * @param b: ArrPtr to the second operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void xorArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n) {
+    bitOpArr(dst, a, &b, start, n, BIT_XOR);
+}
+
+/**
+ * @brief Sets dst[i] to !a[i] for i in [start, start + n) of bool arrays, a word
+ *        (32 elements) at a time
+ *
+ * @param dst: ArrPtr to the result array, may be a
+ * @param a: ArrPtr to the operand
+ * @param start: first index of the range
+ * @param n: number of elements
+ */
+void notArr(const ArrPtr& dst, const ArrPtr& a, int start, int n) {
+    bitOpArr(dst, a, nullptr, start, n, BIT_NOT);
+}
+
+/**
+ * @brief Index of the first true element of a bool array, -1 if there is none
+ *
+ * @param p: ArrPtr to the array
+ * @return int: index of the element
+ */
+int findFirstSet(const ArrPtr& p) {
+    return findNextSet(p, -1);
+}
+
+/**
+ * @brief Index of the first true element after idx of a bool array, -1 if there is
+ *        none. Iterates the set elements together with findFirstSet():
+ *        for (int i = findFirstSet(p); i != -1; i = findNextSet(p, i))
+ *
+ * @param p: ArrPtr to the array
+ * @param idx: index to search after, -1 searches from the start
+ * @return int: index of the element
+ */
+int findNextSet(const ArrPtr& p, int idx) {
+    ThreadCache* tc;
+    if (idx < -1)
+        throw std::runtime_error("Index out of bounds");
+    int* ptr = enterArrRange(p, Type::BOOL, idx + 1, p.width - idx - 1, tc);
+    int found = findBit(ptr, idx + 1, p.width - idx - 1);
+    exitAccess(tc);
+    return found;
+}
+
+/**
+ * @brief Copies elements [srcStart, srcStart + n) of src to [dstStart, dstStart + n) of
+ *        dst with a memmove of the packed payload, the arrays must share a base type
+ *        and the ranges may overlap when dst is src
+ *
+ * @param dst: ArrPtr to the destination array
+ * @param dstStart: first index to write
+ * @param src: ArrPtr to the source array
+ * @param srcStart: first index to read
+ * @param n: number of elements
+ */
+void copyArr(const ArrPtr& dst, int dstStart, const ArrPtr& src, int srcStart, int n) {
+    int d = checkArrRange(dst, src.type, dstStart, n);
+    int s = checkArrRange(src, src.type, srcStart, n);
+    ThreadCache* tc = enterAccess();
+    int* dp = symTable->getPtr(d);
+    int* sp = symTable->getPtr(s);
+    switch (src.type) {
+        case Type::INT:
+            memmove(dp + dstStart, sp + srcStart, (size_t)n << 2);
+            break;
+        case Type::MEDIUM_INT:
+            memmove((char*)dp + (size_t)dstStart * 3, (char*)sp + (size_t)srcStart * 3, (size_t)n * 3);
+            break;
+        case Type::CHAR:
+            memmove((char*)dp + dstStart, (char*)sp + srcStart, n);
+            break;
+        default:
+            copyBits(dp, dstStart, sp, srcStart, n);
+    }
+    exitAccess(tc);
+}
+
+/**
+ * @brief Creates an array holding a copy of elements [start, start + n) of src
+ *
+ * @param src: ArrPtr to the source array
+ * @param start: first index to copy
+ * @param n: number of elements
+ * @return ArrPtr: Ptr to the created array
+ */
+ArrPtr sliceArr(const ArrPtr& src, int start, int n) {
+    checkArrRange(src, src.type, start, n);
+    ArrPtr p = createArr(src.type, n);
+    copyArr(p, 0, src, start, n);
+    return p;
 }
 
 /**
- * @brief Get the value of the array pointed by the ArrPtr and stores it in val
+ * @brief Zeroes elements [from, to) of an array of base type t
  *
- * @param p: ArrPtr to the array
- * @param idx: index of the array
- * @param val: storing the value of the array
+ * @param t: Base type of the array
+ * @param ptr: first word of the array
  */
-void getVar(const ArrPtr& p, int idx, void* val) {
-    int local_addr = p.addr >> 2;
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
+void clearElems(const Type& t, int* ptr, int from, int to) {
+    if (from >= to)
+        return;
+    if (t == Type::BOOL)
+        fillBits(ptr, from, to - from, false);
+    else
+        memset((char*)ptr + (long long)from * getSize(t), 0, (size_t)(to - from) * getSize(t));
+}
+
+/**
+ * @brief Resizes an array to width elements, new elements are zero. The block grows in
+ *        place by absorbing the free block after it (or shrinks in place) and is only
+ *        moved when that is not possible. p keeps its handle when the array grows in
+ *        place, when it shrinks or moves p gets a new one (SymbolTable::renew()) and
+ *        copies of p taken before the call fail like freed handles.
+ *        A pinned array is never moved or shrunk and keeps its handle.
+ *
+ * @param[in,out] p: ArrPtr to the array, its width is updated
+ * @param width: new size of the array
+ */
+void resizeArr(ArrPtr& p, int width) {
+    if (width < 0)
+        throw std::runtime_error("Negative array width");
+    int bytes = arrayBytes(p.type, width);
+    int words = max(((bytes + 3) >> 2) + 2, MIN_BLOCK_WORDS);
+    PTHREAD_MUTEX_LOCK(&mem->mutex);
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr))) {
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
         throw std::runtime_error("Variable not in symbol table");
-    if (idx < 0 || idx >= p.width)
-        throw std::runtime_error("Index out of bounds");
+    }
+    int wordid = symTable->getWordIdx(local_addr);
+    int have = *(mem->start + wordid) >> 1;
+    bool old = nursery == nullptr || !nursery->contains(wordid);
+    bool pinned = symTable->isPinned(local_addr);
+    if (words <= have || (old && mem->extendBlock(wordid, words))) {
+        // blocks don't move while mem->mutex is held
+        if (old && words < have && !pinned) {
+            mem->shrinkBlock(wordid, words);
+            __atomic_add_fetch(&pacer.released, (long long)(have - (*(mem->start + wordid) >> 1)) << 2, __ATOMIC_RELAXED);
+        } else if (words > have) {
+            pacerAlloc((*(mem->start + wordid) >> 1) - have);
+        }
+        clearElems(p.type, symTable->getPtr(local_addr), p.width, width);
+        if (width < p.width && !pinned)
+            p.addr = symTable->renew(local_addr);
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        p.width = width;
+        return;
+    }
+    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    if (pinned)
+        throw std::runtime_error("Resizing a pinned array");
+    int tmp = allocObject(bytes);  // the new block, swapped with the old one below
     PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    int word = getWordForIdx(p.type, idx);
-    int offset = getOffsetForIdx(p.type, idx);
-    ptr = ptr + word;
-    int temp = *ptr;
-    LOG("getVar", _COLOR_BLUE, "Copying 4 bytes from memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    if (p.type == Type::BOOL) {
-        bool b = temp & (1 << offset);
-        memcpy(val, &b, 1);
-    } else
-        memcpy(val, (char*)&temp + offset, getSize(p.type));
+    PTHREAD_MUTEX_LOCK(&symTable->mutex);
+    stopWorld();
+    beginCompactEpoch();
+    bool alive = symTable->lookup(p.addr) != -1 && symTable->isAllocated(local_addr);
+    Handle addr = p.addr;
+    pinned = alive && symTable->isPinned(local_addr);
+    if (alive && !pinned) {
+        wordid = symTable->getWordIdx(local_addr);  // may have moved meanwhile
+        int newid = symTable->getWordIdx(tmp);
+        int copy = min(*(mem->start + wordid) >> 1, *(mem->start + newid) >> 1) - 2;
+        memcpy(mem->start + newid + 1, mem->start + wordid + 1, (size_t)copy << 2);
+        symTable->at(local_addr).word1 = (newid << 1) | 1;
+        symTable->at(tmp).word1 = (wordid << 1) | 1;
+        setOwner(newid, local_addr);
+        clearElems(p.type, mem->start + newid + 1, p.width, width);
+        addr = symTable->renew(local_addr);
+    }
+    __atomic_add_fetch(&pacer.released, objectBytes(tmp), __ATOMIC_RELAXED);
+    _freeElem(tmp);  // frees the old block, or the unused new one
+    endCompactEpoch();
+    resumeWorld();
+    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
     PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    if (!alive)
+        throw std::runtime_error("Variable not in symbol table");
+    if (pinned)
+        throw std::runtime_error("Resizing a pinned array");
+    p.addr = addr;
+    p.width = width;
+}
+
+// marker for start of scope, each thread has its own scope stack
+void initScope() {
+    LOG("initScope", _COLOR_BLUE, "Initializing scope\n");
+    getThreadCache()->stack->push(INVALID_HANDLE);
+}
+
+// pop elements from the thread's stack until the marker, queueing them for the garbage collector
+void endScope() {
+    LOG("endScope", _COLOR_BLUE, "Ending scope");
+    ThreadCache* tc = getThreadCache();
+    Stack* stack = tc->stack;
+    int queued = 0;
+    long long released = 0;
+    PTHREAD_MUTEX_LOCK(&tc->mutex);  // blocks don't move while it is held
+    while (stack->top() != INVALID_HANDLE) {
+        int local_addr = symTable->lookupScoped(stack->pop());
+        if (local_addr != -1 && symTable->isAllocated(local_addr)) {
+            LOG("Endscope", _COLOR_BLUE, "Popping local variable at address, unmarking for GC: %d", translate2La(local_addr));
+            symTable->setUnmarked(local_addr);
+            tc->garbage.push_back(local_addr);
+            released += objectBytes(local_addr);
+            queued++;
+        }
+    }
+    if (queued > 0) {
+        __atomic_add_fetch(&pendingGarbage, queued, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pacer.released, released, __ATOMIC_RELAXED);
+    }
+    PTHREAD_MUTEX_UNLOCK(&tc->mutex);
+    stack->pop();  // pop the scope marker
+    if (queued > 0)
+        gcNotify();
+}
+
+void _freeElem(int local_addr) {
+    if (symTable->isSlot(local_addr)) {
+        freeSlot(local_addr);
+        return;
+    }
+    int wordId = symTable->getWordIdx(local_addr);
+    if (nursery != nullptr && nursery->contains(wordId))
+        nursery->fill(wordId, *(mem->start + wordId) >> 1);
+    else
+        mem->freeBlock(wordId);
+    symTable->free(local_addr);
 }
 
 /**
- * @brief Assign the value of val to the object pointed by the Ptr
+ * @brief Free the memory allocated to the variable pointed by the Ptr
  *
- * @param p: Ptr to the object
- * @param val: value to be assigned
+ * @param p: Ptr to the variable
  */
-void assignVar(const Ptr& p, int val) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::INT)
-        throw std::runtime_error("Assignment to non-int variable");
+void freeElem(const Ptr& p) {
     PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    memcpy((void*)ptr, &val, 4);
-    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    int local_addr = symTable->lookup(p.addr);
+    if (local_addr == -1 || !symTable->isAllocated(local_addr)) {
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        throw std::runtime_error("double free called");
+    }
+    if (symTable->isPinned(local_addr)) {
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        throw std::runtime_error("Freeing a pinned variable");
+    }
+    LOG("FreeElem", _COLOR_BLUE, "Freeing variable at address %llx", p.addr);
+    __atomic_add_fetch(&pacer.released, objectBytes(local_addr), __ATOMIC_RELAXED);
+    _freeElem(local_addr);
+    __atomic_store_n(&compactPending, 1, __ATOMIC_RELAXED);
     PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    gcNotify();
 }
 
 /**
- * @brief Assign the value of val to the object pointed by the Ptr
+ * @brief Construct a new Compact Pool:: Compact Pool object, starts _nthreads - 1 workers
+ * @param _nthreads: number of threads taking part in a task, including the caller
+ */
+CompactPool::CompactPool(int _nthreads) : nthreads(_nthreads), task(nullptr), stop(false) {
+    threads = new pthread_t[nthreads];
+    pthread_barrier_init(&start, nullptr, nthreads);
+    pthread_barrier_init(&done, nullptr, nthreads);
+    for (int i = 1; i < nthreads; i++) {
+        if (pthread_create(&threads[i], nullptr, compactWorker, this) != 0) {
+            throw std::runtime_error("Error creating compaction thread");
+        }
+    }
+    LOG("CompactPool", _COLOR_BLUE, "Created %d compaction threads\n", nthreads - 1);
+}
+
+/**
+ * @brief Destroy the Compact Pool object, the workers are joined
+ */
+CompactPool::~CompactPool() {
+    stop = true;
+    pthread_barrier_wait(&start);
+    for (int i = 1; i < nthreads; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    pthread_barrier_destroy(&start);
+    pthread_barrier_destroy(&done);
+    delete[] threads;
+}
+
+/**
+ * @brief Runs _task on every thread of the pool and waits for all of them
+ */
+void CompactPool::run(void (*_task)()) {
+    task = _task;
+    pthread_barrier_wait(&start);
+    task();
+    pthread_barrier_wait(&done);
+}
+
+void* compactWorker(void* arg) {
+    CompactPool* pool = (CompactPool*)arg;
+    while (true) {
+        pthread_barrier_wait(&pool->start);
+        if (pool->stop)
+            break;
+        pool->task();
+        pthread_barrier_wait(&pool->done);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Runs a compaction task on every compaction thread, work is handed out
+ *        through compactCursor in increasing order
+ */
+void runCompactTask(void (*task)()) {
+    compactCursor = 0;
+    if (compactPool != nullptr)
+        compactPool->run(task);
+    else
+        task();
+}
+
+/**
+ * @brief Splits the heap into block aligned regions of about the same size
+ */
+void splitRegions() {
+    int total = mem->end - mem->start;
+    int n = compactPool != nullptr ? compactPool->nthreads * COMPACT_REGIONS_PER_THREAD : 1;
+    int target = max(total / n, COMPACT_REGION_MIN_WORDS);
+    regions.clear();
+    int* p = mem->start;
+    int begin = 0;
+    while (p < mem->end) {
+        p = p + (*p >> 1);
+        int wordid = p - mem->start;
+        if (wordid - begin >= target || p == mem->end) {
+            CompactRegion r{};
+            r.begin = begin;
+            r.end = wordid;
+            regions.push_back(r);
+            begin = wordid;
+        }
+    }
+}
+
+/**
+ * @brief Sums up the live words of the claimed regions, pinned blocks reset the sum
+ */
+void calcRegionSummary() {
+    int r;
+    while ((r = __atomic_fetch_add(&compactCursor, 1, __ATOMIC_RELAXED)) < (int)regions.size()) {
+        CompactRegion& reg = regions[r];
+        reg.live = reg.liveAfterPin = 0;
+        reg.pinEnd = -1;
+        size_t pin = lower_bound(compactPinned.begin(), compactPinned.end(), reg.begin) - compactPinned.begin();
+        int* p = mem->start + reg.begin;
+        int* end = mem->start + reg.end;
+        while (p < end) {
+            int words = *p >> 1;
+            if (*p & 1) {
+                int wordid = p - mem->start;
+                if (pin < compactPinned.size() && compactPinned[pin] == wordid) {
+                    reg.pinEnd = wordid + words;
+                    reg.liveAfterPin = 0;
+                    pin++;
+                } else {
+                    reg.live += words;
+                    reg.liveAfterPin += words;
+                }
+            }
+            p = p + words;
+        }
+    }
+}
+
+/**
+ * @brief Computes the new word offset of every allocated block of the claimed
+ *        regions and stores it in the block's footer. Blocks slide towards the
+ *        start of the heap, pinned blocks keep their place and the blocks after
+ *        them slide up to their end.
+ */
+void calcOffset() {
+    int r;
+    while ((r = __atomic_fetch_add(&compactCursor, 1, __ATOMIC_RELAXED)) < (int)regions.size()) {
+        CompactRegion& reg = regions[r];
+        reg.gaps.clear();
+        reg.progress = reg.begin;
+        size_t pin = lower_bound(compactPinned.begin(), compactPinned.end(), reg.begin) - compactPinned.begin();
+        int dest = reg.destIn;
+        int* p = mem->start + reg.begin;
+        int* end = mem->start + reg.end;
+        while (p < end) {
+            int words = *p >> 1;
+            if (*p & 1) {
+                int wordid = p - mem->start;
+                if (pin < compactPinned.size() && compactPinned[pin] == wordid) {
+                    if (dest < wordid)
+                        reg.gaps.push_back(make_pair(dest, wordid - dest));
+                    dest = wordid;
+                    pin++;
+                }
+                *(p + words - 1) = (dest << 1) | 1;
+                dest += words;
+            }
+            p = p + words;
+        }
+    }
+}
+
+/**
+ * @brief Points the claimed chunks of the symbol table to the new block offsets
+ */
+void updateSymbolTable() {
+    int c;
+    while ((c = __atomic_fetch_add(&compactCursor, COMPACT_SYMBOL_CHUNK, __ATOMIC_RELAXED)) < symTable->capacity) {
+        int last = min(c + COMPACT_SYMBOL_CHUNK, symTable->capacity);
+        for (int i = c; i < last; i++) {
+            // slots move with their slab
+            if (symTable->isAllocated(i) && !symTable->isSlot(i) && (nursery == nullptr || !nursery->contains(symTable->getWordIdx(i)))) {
+                int* p = symTable->getPtr(i) - 1;
+                int newWordId = *(p + (*p >> 1) - 1) >> 1;
+                symTable->at(i).word1 = (newWordId << 1) | 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Waits until no region before r still has to read a block overlapping
+ *        [lo, hi), the destination of a block of region r
+ */
+inline void waitForSources(int lo, int hi, int r) {
+    int k = r;
+    while (k > 0 && regions[k].begin > lo) {
+        k--;
+    }
+    for (; k < r; k++) {
+        int need = min(hi, regions[k].end);
+        while (__atomic_load_n(&regions[k].progress, __ATOMIC_ACQUIRE) < need) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * @brief Moves the blocks of the claimed regions to their new offsets in address
+ *        order. Regions only write below their own begin into regions that
+ *        already moved the blocks there, so they run in parallel.
+ */
+void slideRegions() {
+    int r;
+    while ((r = __atomic_fetch_add(&compactCursor, 1, __ATOMIC_RELAXED)) < (int)regions.size()) {
+        CompactRegion& reg = regions[r];
+        int* p = mem->start + reg.begin;
+        int* end = mem->start + reg.end;
+        while (p < end) {
+            int words = *p >> 1;
+            if (*p & 1) {
+                int to = *(p + words - 1) >> 1;
+                int* q = mem->start + to;
+                if (q < p) {
+                    if (to < reg.begin)
+                        waitForSources(to, to + words, r);
+                    memmove(q, p, words << 2);
+                }
+                *(q + words - 1) = *q;
+            }
+            p = p + words;
+            __atomic_store_n(&reg.progress, (int)(p - mem->start), __ATOMIC_RELEASE);
+        }
+    }
+}
+
+/**
+ * @brief Slides every block to the start of the heap (around pinned blocks) in
+ *        parallel on the compaction threads: per region live sums, their prefix
+ *        sums, per region forwarding offsets, the symbol table update and the
+ *        moves each run as a task. The world must be stopped.
+ */
+void compactMem() {
+    compactQueue.clear();  // a full compaction ends any incremental one
+    compactNext = 0;
+    compactActive = 0;
+    // allocation buffers are tagged as allocated blocks, the world must be stopped
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->retire();
+    }
+    beginCompactEpoch();
+    // tiny blocks are only tagged as allocated, release them before sliding
+    for (int t = mem->tinyList; t != -1;) {
+        int* p = mem->start + t;
+        t = *(p + 1);
+        *p = MIN_BLOCK_WORDS << 1;
+        *(p + MIN_BLOCK_WORDS - 1) = MIN_BLOCK_WORDS << 1;
+    }
+    // pin counts can only change inside an accessor, they are stable from here on
+    compactPinned.clear();
+    for (int i = 0; i < symTable->capacity; i++) {
+        if (symTable->isAllocated(i) && symTable->isPinned(i)) {
+            compactPinned.push_back(symTable->getWordIdx(i));
+        }
+    }
+    if (mem->growable) {
+        // chunk fenceposts stay in place like pinned blocks, nothing slides across them
+        for (HeapChunk& c : mem->chunks) {
+            compactPinned.push_back(c.end - MIN_BLOCK_WORDS);
+        }
+    }
+    sort(compactPinned.begin(), compactPinned.end());
+    splitRegions();
+    runCompactTask(calcRegionSummary);
+    int dest = 0;
+    for (CompactRegion& reg : regions) {
+        reg.destIn = dest;
+        dest = reg.pinEnd != -1 ? reg.pinEnd + reg.liveAfterPin : dest + reg.live;
+    }
+    runCompactTask(calcOffset);
+    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Updating memory offsets\n");
+    runCompactTask(updateSymbolTable);
+    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Updating symbol table with new logical address\n");
+    runCompactTask(slideRegions);
+    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Compact memory complete\n");
+    // the only free blocks left are the gaps in front of pinned blocks and the end of the heap
+    mem->resetFreeLists();
+    for (CompactRegion& reg : regions) {
+        for (pair<int, int>& gap : reg.gaps) {
+            int* p = mem->start + gap.first;
+            *p = gap.second << 1;
+            *(p + gap.second - 1) = gap.second << 1;
+            mem->insertFree(p);
+        }
+    }
+    int total = mem->end - mem->start;
+    if (dest < total) {
+        int* p = mem->start + dest;
+        *p = (total - dest) << 1;
+        *(p + (total - dest) - 1) = (total - dest) << 1;
+        mem->insertFree(p);
+    }
+    mem->releaseFree();
+    endCompactEpoch();
+}
+
+/**
+ * @brief Sets the pause budget of an incremental compaction step, a step stops
+ *        after moving bytes bytes or running for us microseconds, whichever
+ *        comes first (at least one block is moved per step)
  *
- * @param p: Ptr to the object
- * @param val: value to be assigned
+ * @param us: time budget in microseconds
+ * @param bytes: bytes moved per step
  */
-void assignVar(const Ptr& p, medium_int val) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::MEDIUM_INT)
-        throw std::runtime_error("Assignment to non-int variable");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    int temp = val.to_int();
-    memcpy((void*)ptr, &temp, 4);
-    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+void setCompactBudget(int us, int bytes) {
+    compactStepUs = max(us, 1);
+    compactStepBytes = max(bytes, 4);
+}
 
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+/**
+ * @brief Starts an incremental compaction cycle by queueing the blocks of the old
+ *        generation in address order, the world must be stopped
+ */
+void beginIncrementalCompaction() {
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->retire();
+    }
+    compactQueue.clear();
+    compactNext = 0;
+    for (int i = 0; i < symTable->capacity; i++) {
+        if (symTable->isAllocated(i) && !symTable->isSlot(i) && (nursery == nullptr || !nursery->contains(symTable->getWordIdx(i)))) {
+            compactQueue.push_back(make_pair(symTable->getWordIdx(i), i));
+        }
+    }
+    sort(compactQueue.begin(), compactQueue.end());
+    __atomic_store_n(&compactActive, 1, __ATOMIC_RELAXED);
+    LOG("Garbage Collector", _COLOR_GREEN, "Incremental compaction of %zu blocks\n", compactQueue.size());
 }
 
 /**
- * @brief Assign the value of val to the object pointed by the Ptr
+ * @brief Runs one slice of an incremental compaction: every queued block slides
+ *        into the free block right in front of it and the hole moves up, merging
+ *        with the free blocks after it. The heap is consistent after every block,
+ *        so mutators run between the slices. Queue entries whose block was freed
+ *        or whose symbol was reused since the cycle started are skipped.
+ *        mem->mutex and symTable->mutex must be held and the world must be stopped.
  *
- * @param p: Ptr to the object
- * @param val: value to be assigned
+ * @return bool: true if the cycle is complete
  */
-void assignVar(const Ptr& p, bool f) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::BOOL)
-        throw std::runtime_error("Assignment to non-bool variable");
+bool compactStep() {
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->retire();
+    }
+    timespec t0, t;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long moved = 0;
+    beginCompactEpoch();
+    while (compactNext < compactQueue.size()) {
+        int wordid = compactQueue[compactNext].first, sym = compactQueue[compactNext].second;
+        compactNext++;
+        if (!symTable->isAllocated(sym) || symTable->getWordIdx(sym) != wordid || symTable->isPinned(sym))
+            continue;
+        int* p = mem->start + wordid;
+        if (p == mem->start || ((*(p - 1) & 1) && !IS_TINY_FOOTER(*(p - 1))))
+            continue;  // nothing free in front of it
+        int words = *p >> 1;
+        int holeWords = IS_TINY_FOOTER(*(p - 1)) ? MIN_BLOCK_WORDS : *(p - 1) >> 1;
+        int* hole = p - holeWords;
+        if (holeWords == MIN_BLOCK_WORDS)
+            mem->removeTiny(hole);
+        else
+            mem->removeFree(hole);
+        memmove(hole, p, words << 2);
+        symTable->at(sym).word1 = ((hole - mem->start) << 1) | 1;
+        int* rest = hole + words;
+        *rest = (holeWords << 1) | 1;  // freeBlock merges it with a free block after it
+        mem->freeBlock(rest - mem->start);
+        moved += words << 2;
+        if (moved >= compactStepBytes)
+            break;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        if ((t.tv_sec - t0.tv_sec) * 1000000L + (t.tv_nsec - t0.tv_nsec) / 1000 >= compactStepUs)
+            break;
+    }
+    endCompactEpoch();
+    LOG("Garbage Collector", _COLOR_GREEN, "Compaction step: moved %ld bytes\n", moved);
+    if (compactNext < compactQueue.size())
+        return false;
+    compactQueue.clear();
+    compactNext = 0;
+    __atomic_store_n(&compactActive, 0, __ATOMIC_RELAXED);
+    mem->releaseFree();
+    return true;
+}
+
+/**
+ * @brief Moves the nursery block at p owned by sym to the old generation,
+ *        objects must not be accessed concurrently
+ *
+ * @return int: new word offset of the block, -1 if the old generation is full
+ */
+int promote(int* p, int sym) {
+    int words = *p >> 1;
+    int wordid = mem->getMem((words - 2) << 2);
+    if (wordid == -1)
+        return -1;
+    memcpy(mem->start + wordid + 1, p + 1, (words - 2) << 2);
+    symTable->at(sym).word1 = (wordid << 1) | 1;
+    nursery->fill(p - mem->start, words);
+    return wordid;
+}
+
+/**
+ * @brief Minor collection: collects the unreachable objects of the nursery and
+ *        copies the survivors to the other semispace, or to the old generation once
+ *        they survived PROMOTE_AGE collections. Only the used part of the active
+ *        semispace is visited. mem->mutex and symTable->mutex must be held and the
+ *        world must be stopped.
+ */
+void minorCollect() {
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->retire();
+    }
+    int from = nursery->active, to = 1 - from;
+    int* p = mem->start + nursery->base[from];
+    int* top = mem->start + nursery->top;
+    int* dest = mem->start + nursery->base[to];
+    if (p == top)
+        return;
+    beginCompactEpoch();
+    int promoted = 0, survived = 0;
+    while (p < top) {
+        int words = *p >> 1;
+        int owner = *(p + words - 1);
+        if (owner != NURSERY_FILLER) {
+            int sym = owner >> NURSERY_AGE_BITS;
+            int age = (owner & ((1 << NURSERY_AGE_BITS) - 1)) + 1;
+            if (!symTable->isMarked(sym)) {
+                LOG("Garbage Collector", _COLOR_GREEN, "Collecting nursery variable at addr %d\n", translate2La(sym));
+                symTable->free(sym);
+            } else if (age >= PROMOTE_AGE && promote(p, sym) != -1) {
+                promoted++;
+            } else {
+                memcpy(dest, p, words << 2);
+                *(dest + words - 1) = (sym << NURSERY_AGE_BITS) | min(age, (1 << NURSERY_AGE_BITS) - 1);
+                symTable->at(sym).word1 = ((dest - mem->start) << 1) | 1;
+                dest += words;
+                survived++;
+            }
+        }
+        p = p + words;
+    }
+    nursery->active = to;
+    nursery->top = dest - mem->start;
+    endCompactEpoch();
+    LOG("Garbage Collector", _COLOR_GREEN, "Minor collection: %d survived, %d promoted\n", survived, promoted);
+}
+
+/**
+ * @brief Frees the queued symbols that are still out of scope, entries may be stale
+ *        (freed or reused since they were queued) or pinned and are then dropped,
+ *        unpinArr queues pinned ones again. The world must be stopped.
+ */
+void sweepGarbage(vector<int>& garbage) {
+    for (int i : garbage) {
+        if (symTable->isAllocated(i) && !symTable->isMarked(i) && !symTable->isPinned(i)) {
+            LOG("Garbage Collector", _COLOR_GREEN, "Collecting out of scope variable at addr %d\n", translate2La(i));
+            _freeElem(i);
+        }
+    }
+    garbage.clear();
+}
+
+/**
+ * @brief Sweeps the garbage queued by every thread, mem->mutex and
+ *        symTable->mutex must be held and the world must be stopped
+ */
+void sweepQueued() {
+    __atomic_store_n(&pendingGarbage, 0, __ATOMIC_RELAXED);
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        sweepGarbage(tc->garbage);
+    }
+    sweepGarbage(orphanGarbage);
+}
+
+/**
+ * @brief Runs a collection cycle, its cost is proportional to the garbage queued
+ *        by endScope since the last one, nothing is locked if there is none and
+ *        nothing was freed explicitly
+ */
+void gc_run() {
+    if (!gcHasWork())
+        return;
     PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    int temp = f ? 1 : 0;
-    memcpy((void*)ptr, &temp, 4);
-    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
+    PTHREAD_MUTEX_LOCK(&symTable->mutex);
+    stopWorld();
+    __atomic_store_n(&compactPending, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&pacer.allocated, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&pacer.released, 0, __ATOMIC_RELAXED);
+    if (nursery != nullptr) {
+        minorCollect();
+    }
+    sweepQueued();
+    if (!compactActive) {
+        // free memory can only be gathered within a chunk
+        int chunkFree = 0;
+        for (HeapChunk& c : mem->chunks) {
+            chunkFree = max(chunkFree, c.freeWords);
+        }
+        double free_ratio = (double)chunkFree / (double)max(mem->biggestFreeBlockSize, 1);
+        if (free_ratio >= COMPACT_THRESHOLD) {
+            LOG("Garbage Collector", _COLOR_GREEN, "Free ratio: %f, compacting memory\n", free_ratio);
+            beginIncrementalCompaction();
+        }
+    }
+    if (compactActive) {
+        compactStep();  // one pause-bounded slice per cycle, the next cycles continue it
+    }
+    resumeWorld();
+    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
     PTHREAD_MUTEX_UNLOCK(&mem->mutex);
 }
 
 /**
- * @brief Assign the value of val to the object pointed by the Ptr
- *
- * @param p: Ptr to the object
- * @param val: value to be assigned
+ * @brief Tells if a collection cycle has anything to do: garbage queued by
+ *        endScope, memory freed by freeElem or an incremental compaction to continue
+ */
+bool gcHasWork() {
+    return __atomic_load_n(&pendingGarbage, __ATOMIC_SEQ_CST) != 0 || __atomic_load_n(&compactPending, __ATOMIC_SEQ_CST) != 0 ||
+           __atomic_load_n(&compactActive, __ATOMIC_SEQ_CST) != 0;
+}
+
+/**
+ * @brief Sets the initial allocation budget from the heap size
+ */
+void GcPacer::init(long long heapBytes) {
+    allocated = released = 0;
+    heap = heapBytes;
+    minBudget = max(heapBytes >> GC_MIN_BUDGET_SHIFT, 1LL);
+    maxBudget = max(heapBytes >> GC_MAX_BUDGET_SHIFT, 1LL);
+    budget = max(heapBytes >> GC_BUDGET_SHIFT, 1LL);
+}
+
+/**
+ * @brief Scales the budget limits to a grown heap, the budget itself adapts
+ */
+void GcPacer::resize(long long heapBytes) {
+    heap = heapBytes;
+    minBudget = max(heapBytes >> GC_MIN_BUDGET_SHIFT, 1LL);
+    maxBudget = max(heapBytes >> GC_MAX_BUDGET_SHIFT, 1LL);
+}
+
+/**
+ * @brief Tells if a background cycle is due: the bytes allocated or released
+ *        since the last one reached the budget, the heap is filled past the
+ *        watermark while there is garbage, or an incremental compaction is running
+ */
+bool GcPacer::due() {
+    if (__atomic_load_n(&compactActive, __ATOMIC_SEQ_CST))
+        return true;
+    long long b = __atomic_load_n(&budget, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&allocated, __ATOMIC_SEQ_CST) >= b || __atomic_load_n(&released, __ATOMIC_SEQ_CST) >= b)
+        return true;
+    if (__atomic_load_n(&pendingGarbage, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&compactPending, __ATOMIC_SEQ_CST) == 0)
+        return false;
+    long long used = heap - ((long long)__atomic_load_n(&mem->totalFreeMem, __ATOMIC_RELAXED) << 2);
+    return used >= heap * watermark;
+}
+
+/**
+ * @brief Adapts the budget after a cycle: it doubles while the collector takes
+ *        more than the target fraction of the time and halves while it takes
+ *        less than half of it
+ *
+ * @param cycleNs: duration of the cycle
+ * @param periodNs: time since the end of the previous cycle
+ */
+void GcPacer::adapt(long long cycleNs, long long periodNs) {
+    if (periodNs <= 0)
+        return;
+    double fraction = (double)cycleNs / (double)periodNs;
+    long long b = budget;
+    if (fraction > target)
+        b = min(b << 1, maxBudget);
+    else if (fraction < target / 2)
+        b = max(b >> 1, minBudget);
+    if (b != budget) {
+        LOG("Garbage Collector", _COLOR_GREEN, "GC time fraction %f, allocation budget %lld bytes\n", fraction, b);
+        __atomic_store_n(&budget, b, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Counts an allocation from the heap or nursery and wakes the collector
+ *        when it uses up the budget, mem->mutex must be held
  */
-void assignVar(const Ptr& p, char c) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::CHAR)
-        throw std::runtime_error("Assignment to non-char variable");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    int temp = c;
-    memcpy((void*)ptr, &temp, 4);
-    LOG("assignVar", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+void pacerAlloc(int words) {
+    long long bytes = (long long)words << 2;
+    long long total = __atomic_add_fetch(&pacer.allocated, bytes, __ATOMIC_RELAXED);
+    long long b = __atomic_load_n(&pacer.budget, __ATOMIC_RELAXED);
+    if (total >= b && total - bytes < b)
+        gcNotify();
 }
 
 /**
- * @brief Assign the value of val to an index of the array pointed by the ArrPtr
+ * @brief Sets the pacing of the background collection cycles
  *
- * @param p: ArrPtr to the array
- * @param idx: index of the array
- * @param val: value to be assigned
+ * @param budget: bytes allocated or released that start a cycle, 0 to derive it from the heap size
+ * @param watermark: fraction of the heap in use above which any garbage starts a cycle
+ * @param cpuFraction: share of the time the collector aims to take, the budget adapts to it
  */
-void assignArr(const ArrPtr& p, int idx, int val) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::INT)
-        throw std::runtime_error("Assignment to non-int array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    int word = getWordForIdx(p.type, idx);
-    int offset = getOffsetForIdx(p.type, idx);
-    ptr = (int*)((char*)ptr + word * 4 + offset);
-    memcpy((void*)ptr, &val, 4);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+void setGcPacing(int budget, double watermark, double cpuFraction) {
+    if (watermark <= 0 || watermark > 1 || cpuFraction <= 0 || cpuFraction >= 1)
+        throw std::runtime_error("Invalid GC pacing");
+    pacer.watermark = watermark;
+    pacer.target = cpuFraction;
+    if (budget > 0) {
+        pacer.minBudget = pacer.maxBudget = budget;
+        __atomic_store_n(&pacer.budget, (long long)budget, __ATOMIC_RELAXED);
+    } else if (mem != nullptr) {
+        pacer.init(pacer.heap);
+    }
+    gcNotify();
 }
 
 /**
- * @brief Assign the value of val to an index of the array pointed by the ArrPtr
- *
- * @param p: ArrPtr to the array
- * @param idx: index of the array
- * @param val: value to be assigned
+ * @brief Wakes the collector thread after new work was published, the mutex is
+ *        only taken if the collector is idle
  */
-void assignArr(const ArrPtr& p, int idx, medium_int val) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::MEDIUM_INT)
-        throw std::runtime_error("Assignment to non-medium-int array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    int word = getWordForIdx(p.type, idx);
-    int offset = getOffsetForIdx(p.type, idx);
-    ptr = (int*)((char*)ptr + word * 4 + offset);
-    int temp = val.to_int();
-    memcpy((void*)ptr, &temp, 4);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+void gcNotify() {
+    if (gcSched != nullptr)
+        gcSched->notify();
+}
+
+inline long long monotonicNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
 /**
- * @brief Assign the value of val to an index of the array pointed by the ArrPtr
- *
- * @param p: ArrPtr to the array
- * @param idx: index of the array
- * @param val: value to be assigned
+ * @brief Construct a new Gc Scheduler:: Gc Scheduler object, the condition
+ *        variables use the monotonic clock for the timed waits of the pacing
  */
-void assignArr(const ArrPtr& p, int idx, char c) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::CHAR)
-        throw std::runtime_error("Assignment to non-char array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    int word = getWordForIdx(p.type, idx);
-    int offset = getOffsetForIdx(p.type, idx);
-    ptr = ptr + word;
-    int temp = *ptr;
-    memcpy((char*)&temp + offset, &c, 1);
-    memcpy((void*)ptr, &temp, 4);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+GcScheduler::GcScheduler() : requested(0), completed(0), idle(0), stop(false), nextRunNs(0), lastEndNs(0) {
+    memset(&stats, 0, sizeof(stats));
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&wake, &attr);
+    pthread_cond_init(&done, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+GcScheduler::~GcScheduler() {
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&wake);
+    pthread_cond_destroy(&done);
 }
 
 /**
- * @brief Assign the value of val to an index of the array pointed by the ArrPtr
- *
- * @param p: ArrPtr to the array
- * @param idx: index of the array
- * @param val: value to be assigned
+ * @brief Wakes the collector if it is waiting for work. The work must be
+ *        published before the call, the collector announces itself idle before
+ *        checking for work, so one of the two always sees the other.
  */
-void assignArr(const ArrPtr& p, int idx, bool f) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::BOOL)
-        throw std::runtime_error("Assignment to non-bool array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    LOG("assignArr", _COLOR_BLUE, "Assigned 4 bytes to memory at logical address: %ld\n", (ptr - mem->start) << 2);
-    int word = getWordForIdx(p.type, idx);
-    int offset = getOffsetForIdx(p.type, idx);
-    ptr = ptr + word;
-    int temp = *ptr;
-    temp = temp & ~(1 << offset);
-    temp = temp | (f << offset);
-    memcpy((void*)ptr, &temp, 4);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+void GcScheduler::notify() {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&idle, __ATOMIC_SEQ_CST)) {
+        PTHREAD_MUTEX_LOCK(&mutex);
+        pthread_cond_signal(&wake);
+        PTHREAD_MUTEX_UNLOCK(&mutex);
+    }
 }
 
 /**
- * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr
+ * @brief Asks for a collection cycle
  *
- * @param p: ArrPtr to the array
- * @param arr: array of values to be assigned
- * @param n: size of the array
+ * @param wait: if true, blocks until a cycle started after the request completed
  */
-void assignArr(const ArrPtr& p, int arr[], int n) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::INT)
-        throw std::runtime_error("Assignment to non-int array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    for (int i = 0; i < n; i++) {
-        int word = getWordForIdx(p.type, i);
-        int offset = getOffsetForIdx(p.type, i);
-        int* ptr_temp = (int*)((char*)ptr + word * 4 + offset);
-        memcpy((void*)ptr_temp, &arr[i], 4);
+void GcScheduler::request(bool wait) {
+    PTHREAD_MUTEX_LOCK(&mutex);
+    unsigned long ticket = ++requested;
+    pthread_cond_signal(&wake);
+    while (wait && completed < ticket && !stop) {
+        pthread_cond_wait(&done, &mutex);
     }
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    PTHREAD_MUTEX_UNLOCK(&mutex);
 }
 
 /**
- * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr
- *
- * @param p: ArrPtr to the array
- * @param arr: array of values to be assigned
- * @param n: size of the array
+ * @brief Stops the collector thread and releases the callers waiting on it
  */
-void assignArr(const ArrPtr& p, medium_int arr[], int n) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::MEDIUM_INT)
-        throw std::runtime_error("Assignment to non-medium-int array");
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    for (int i = 0; i < n; i++) {
-        int word = getWordForIdx(p.type, i);
-        int offset = getOffsetForIdx(p.type, i);
-        int* ptr_temp = (int*)((char*)ptr + word * 4 + offset);
-        memcpy((void*)ptr_temp, &arr[i].data, 4);
-    }
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+void GcScheduler::shutdown() {
+    PTHREAD_MUTEX_LOCK(&mutex);
+    stop = true;
+    pthread_cond_signal(&wake);
+    pthread_cond_broadcast(&done);
+    PTHREAD_MUTEX_UNLOCK(&mutex);
 }
 
 /**
- * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr
+ * @brief Blocks the collector until a cycle is due: right away for gcActivate
+ *        requests, once the pacer asks for one (see GcPacer::due()) no sooner
+ *        than GC_PERIOD_US after the end of the last cycle
  *
- * @param p: ArrPtr to the array
- * @param arr: array of values to be assigned
- * @param n: size of the array
+ * @param seq: set to the last request the cycle serves
+ * @return bool: false on shutdown
  */
-void assignArr(const ArrPtr& p, char arr[], int n) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::CHAR)
-        throw std::runtime_error("Assignment to non-char array");
-
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    for (int i = 0; i < n; i++) {
-        int word = getWordForIdx(p.type, i);
-        int offset = getOffsetForIdx(p.type, i);
-        int* ptr_temp = ptr + word;
-        int temp = *ptr_temp;
-        memcpy((char*)&temp + offset, &arr[i], 1);
-        memcpy(ptr_temp, &temp, 4);
+bool GcScheduler::next(unsigned long* seq) {
+    PTHREAD_MUTEX_LOCK(&mutex);
+    while (!stop && requested == completed) {
+        __atomic_store_n(&idle, 1, __ATOMIC_SEQ_CST);
+        if (pacer.due()) {
+            __atomic_store_n(&idle, 0, __ATOMIC_RELAXED);
+            if (monotonicNs() >= nextRunNs)
+                break;
+            timespec ts = {(time_t)(nextRunNs / 1000000000LL), (long)(nextRunNs % 1000000000LL)};
+            pthread_cond_timedwait(&wake, &mutex, &ts);
+            continue;
+        }
+        pthread_cond_wait(&wake, &mutex);
+        __atomic_store_n(&idle, 0, __ATOMIC_RELAXED);
     }
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    *seq = requested;
+    bool running = !stop;
+    PTHREAD_MUTEX_UNLOCK(&mutex);
+    return running;
 }
 
 /**
- * @brief Assign values of arr from 0 to n-1, to the array pointed by the ArrPtr
+ * @brief Records a finished cycle and wakes the callers waiting for it
  *
- * @param p: ArrPtr to the array
- * @param arr: array of values to be assigned
- * @param n: size of the array
+ * @param seq: last request the cycle served
+ * @param ns: duration of the cycle
  */
-void assignArr(const ArrPtr& p, bool arr[], int n) {
-    int local_addr = translate2Idx(p.addr);
-    if (!(symTable->isAllocated(local_addr) && symTable->isMarked(local_addr)))
-        throw std::runtime_error("Variable not in symbol table");
-    if (p.type != Type::BOOL)
-        throw std::runtime_error("Assignment to non-bool array");
+void GcScheduler::complete(unsigned long seq, long long ns) {
+    PTHREAD_MUTEX_LOCK(&mutex);
+    completed = seq;
+    stats.cycles++;
+    stats.lastCycleNs = ns;
+    stats.maxCycleNs = max(stats.maxCycleNs, ns);
+    stats.totalCycleNs += ns;
+    long long now = monotonicNs();
+    if (lastEndNs != 0)
+        pacer.adapt(ns, now - lastEndNs);
+    lastEndNs = now;
+    nextRunNs = now + GC_PERIOD_US * 1000LL;
+    pthread_cond_broadcast(&done);
+    PTHREAD_MUTEX_UNLOCK(&mutex);
+}
 
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    int* ptr = symTable->getPtr(local_addr);
-    for (int i = 0; i < n; i++) {
-        int word = getWordForIdx(p.type, i);
-        int offset = getOffsetForIdx(p.type, i);
-        int* ptr_temp = ptr + word;
-        int temp = *ptr_temp;
-        temp = temp & ~(1 << offset);
-        temp = temp | (arr[i] << offset);
-        memcpy((void*)ptr_temp, &temp, 4);
+void* garbageCollector(void*) {
+    unsigned long seq;
+    while (gcSched->next(&seq)) {
+        long long start = monotonicNs();
+        gc_run();
+        gcSched->complete(seq, monotonicNs() - start);
     }
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    return nullptr;
 }
 
-// marker for start of scope
-void initScope() {
-    LOG("initScope", _COLOR_BLUE, "Initializing scope\n");
-    stack->push(-1);
+/**
+ * @brief Asks the garbage collector thread for a collection cycle
+ *
+ * @param wait: if true, returns only once the cycle completed
+ */
+void gcActivate(bool wait) {
+    LOG("Garbage Collector", _COLOR_GREEN, "Signalled garbage collector\n");
+    if (gc_active)
+        gcSched->request(wait);
 }
 
-// pop elements from stack until -1
-void endScope() {
-    LOG("endScope", _COLOR_BLUE, "Ending scope");
-    while (stack->top() != -1) {
-        int local_addr = stack->pop();
-        PTHREAD_MUTEX_LOCK(&symTable->mutex);
-        if (symTable->isAllocated(local_addr)) {
-            LOG("Endscope", _COLOR_BLUE, "Popping local variable at address, unmarking for GC: %d", translate2La(local_addr));
-            symTable->setUnmarked(local_addr);
-        }
-        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
+const char* pageModeName(PageMode mode) {
+    switch (mode) {
+        case HUGETLB_PAGES:
+            return "hugetlb pages";
+        case TRANSPARENT_HUGE_PAGES:
+            return "transparent huge pages";
+        default:
+            return "small pages";
     }
-    stack->pop();  // pop -1
 }
 
-void _freeElem(int local_addr) {
-    int wordId = symTable->getWordIdx(local_addr);
-    mem->freeBlock(wordId);
-    symTable->free(local_addr);
+/**
+ * @brief Returns the page size the heap was mapped with
+ */
+PageMode getPageMode() {
+    if (mem == nullptr)
+        throw std::runtime_error("Memory not created");
+    return mem->pageMode;
 }
 
 /**
- * @brief Free the memory allocated to the variable pointed by the Ptr
- *
- * @param p: Ptr to the variable
+ * @brief Returns the timings of the collection cycles run so far
  */
-void freeElem(const Ptr& p) {
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    PTHREAD_MUTEX_LOCK(&symTable->mutex);
-    int local_addr = translate2Idx(p.addr);
-    if (symTable->isAllocated(local_addr)) {
-        LOG("FreeElem", _COLOR_BLUE, "Freeing variable at address %d", p.addr);
-        _freeElem(local_addr);
-    } else {
-        throw std::runtime_error("double free called");
+GcStats gcStats() {
+    GcStats s;
+    memset(&s, 0, sizeof(s));
+    if (gcSched != nullptr) {
+        PTHREAD_MUTEX_LOCK(&gcSched->mutex);
+        s = gcSched->stats;
+        PTHREAD_MUTEX_UNLOCK(&gcSched->mutex);
     }
-    PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
-    PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    return s;
 }
 
-void calcOffset() {
-    int* p = mem->start;
-    int offset = 0;
-    while (p < mem->end) {
-        if ((*p & 1) == 0) {
-            offset += (*p >> 1);
-        } else {
-            *(p + (*p >> 1) - 1) = (((p - offset) - mem->start) << 1) | 1;
+/**
+ * @brief 64 bit checksum of len bytes (a multiple of 4), four independent
+ *        lanes keep it close to memory bandwidth
+ */
+static unsigned long long checksum(const void* data, size_t len, unsigned long long seed) {
+    const unsigned long long prime = 0x100000001b3ULL;
+    const unsigned char* p = (const unsigned char*)data;
+    unsigned long long h[4] = {seed, seed ^ 0x9e3779b97f4a7c15ULL, seed + prime, ~seed};
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        unsigned long long w[4];
+        memcpy(w, p + i, 32);
+        for (int k = 0; k < 4; k++) {
+            h[k] = (h[k] ^ w[k]) * prime;
         }
-        p = p + (*p >> 1);
     }
-    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Updating memory offsets\n");
+    for (; i + 4 <= len; i += 4) {
+        unsigned int w;
+        memcpy(&w, p + i, 4);
+        h[0] = (h[0] ^ w) * prime;
+    }
+    return ((h[0] * 31 + h[1]) * 31 + h[2]) * 31 + h[3];
 }
 
-void updateSymbolTable() {
-    for (int i = 0; i < symTable->capacity; i++) {
-        if (symTable->isAllocated(i)) {
-            int* p = symTable->getPtr(i) - 1;
-            int newWordId = *(p + (*p >> 1) - 1) >> 1;
-            symTable->symbols[i].word1 = (newWordId << 1) | 1;
-        }
+/**
+ * @brief Writes len bytes at the current file offset, throws on failure
+ */
+static void writeAll(int fd, const void* data, size_t len) {
+    const char* p = (const char*)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0)
+            throw std::runtime_error("Error writing snapshot");
+        p += n;
+        len -= n;
     }
-    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Updating symbol table with new logical address\n");
 }
 
-void compactMem() {
-    calcOffset();
-    updateSymbolTable();
-    int* p = mem->start;
-    int* next = p + (*p >> 1);
-    while (next != mem->end) {
-        if ((*p & 1) == 0 && (*next & 1) == 1) {
-            int word1 = *p >> 1;
-            int word2 = *next >> 1;
-            memcpy(p, next, word2 << 2);
-            p = p + word2;
-            *p = word1 << 1;
-            *(p + word1 - 1) = word1 << 1;
-            next = p + word1;
-            if (next != mem->end && (*next & 1) == 0) {
-                word1 = word1 + (*next >> 1);
-                *p = word1 << 1;
-                *(p + word1 - 1) = word1 << 1;
-                next = p + word1;
-            }
-        } else {
-            p = next;
-            next = p + (*p >> 1);
-        }
-    }
-    LOG("Garbage Collector", _COLOR_GREEN, "Compaction: Compact memory complete\n");
-    p = mem->start;
-    while (p < mem->end) {
-        *(p + (*p >> 1) - 1) = *p;
-        p = p + (*p >> 1);
+/**
+ * @brief Reads len bytes at the current file offset, returns false if the file is shorter
+ */
+static bool readAll(int fd, void* data, size_t len) {
+    char* p = (char*)data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
     }
-    mem->biggestFreeBlockSize = mem->totalFreeMem;
-    mem->totalFreeBlocks = 1;
+    return true;
 }
 
-void gc_run() {
+/**
+ * @brief Writes the heap, its free lists, the symbol table and the used part of
+ *        the nursery to path (through a temporary file renamed over it). The heap
+ *        is written page aligned so that restoreMem can map it back. Queued
+ *        garbage is swept first, allocation buffers and reserved symbols are
+ *        returned, accessors wait while the snapshot is written.
+ *
+ * @param path: file to write
+ * @param root: variable restoreMem returns, to find the data again (may be nullptr)
+ */
+void snapshotMem(const char* path, const ArrPtr* root) {
+    string tmp = string(path) + ".tmp";
+    int fd = open(tmp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd == -1)
+        throw std::runtime_error("Error creating snapshot file");
     PTHREAD_MUTEX_LOCK(&mem->mutex);
     PTHREAD_MUTEX_LOCK(&symTable->mutex);
-    for (int i = 0; i < symTable->capacity; i++) {
-        if (symTable->isAllocated(i) && !symTable->isMarked(i)) {
-            LOG("Garbage Collector", _COLOR_GREEN, "Collecting out of scope variable at addr %d\n", translate2La(i));
-            _freeElem(i);
-        }
+    stopWorld();
+    sweepQueued();
+    compactQueue.clear();  // an incremental compaction is not resumed after a restore
+    compactNext = 0;
+    __atomic_store_n(&compactActive, 0, __ATOMIC_RELAXED);
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->retire();
+        tc->releaseSymbols();
     }
-    mem->totalFreeMem = max(mem->totalFreeMem, 1);
-    double free_ratio = (double)mem->totalFreeMem / (double)(mem->biggestFreeBlockSize);
-    if (free_ratio >= COMPACT_THRESHOLD) {
-        LOG("Garbage Collector", _COLOR_GREEN, "Free ratio: %f, compacting memory\n", free_ratio);
-        compactMem();
+    beginCompactEpoch();
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.heapWords = mem->end - mem->start;
+    h.limitBytes = (mem->limit - mem->start) << 2;
+    h.growable = mem->growable;
+    h.pageMode = mem->pageMode;
+    h.chunkCount = mem->chunks.size();
+    h.flBitmap = mem->flBitmap;
+    memcpy(h.slBitmap, mem->slBitmap, sizeof(h.slBitmap));
+    memcpy(h.freeLists, mem->freeLists, sizeof(h.freeLists));
+    h.tinyList = mem->tinyList;
+    h.tinyCount = mem->tinyCount;
+    h.totalFreeMem = mem->totalFreeMem;
+    h.totalFreeBlocks = mem->totalFreeBlocks;
+    h.biggestFreeBlockSize = mem->biggestFreeBlockSize;
+    h.symCapacity = symTable->capacity;
+    h.symSize = symTable->size;
+    h.freeTop = symTable->freeTop;
+    int* nurseryFrom = nullptr;
+    if (nursery != nullptr) {
+        h.nurseryWords = nursery->words;
+        h.nurseryBase = nursery->base[0];
+        h.nurseryActive = nursery->active;
+        h.nurseryTop = nursery->top;
+        nurseryFrom = mem->start + nursery->base[nursery->active];
+        h.nurseryUsed = nursery->top - nursery->base[nursery->active];
+    }
+    h.rootAddr = INVALID_HANDLE;
+    if (root != nullptr) {
+        h.rootType = root->type;
+        h.rootAddr = root->addr;
+        h.rootWidth = root->width;
+    }
+    size_t slabBytes = 0;
+    for (int t = 0; t < SLAB_CLASSES; t++) {
+        h.slabPartial[t] = slabClasses[t].partial.size();
+        slabBytes += h.slabPartial[t] * sizeof(int);
     }
+    long page = sysconf(_SC_PAGESIZE);
+    size_t meta = sizeof(h) + h.chunkCount * sizeof(HeapChunk) + (size_t)h.symCapacity * sizeof(Symbol) + ((size_t)h.nurseryUsed << 2) + slabBytes;
+    h.heapOffset = (meta + page - 1) / page * page;
+    size_t heapBytes = (size_t)h.heapWords << 2;
+    unsigned long long sum = checksum(&h, sizeof(h), 0);
+    sum = checksum(mem->chunks.data(), h.chunkCount * sizeof(HeapChunk), sum);
+    for (int i = 0; i < h.symCapacity; i += SYM_SEGMENT_SIZE) {
+        sum = checksum(&symTable->at(i), (size_t)min(SYM_SEGMENT_SIZE, h.symCapacity - i) * sizeof(Symbol), sum);
+    }
+    sum = checksum(nurseryFrom, (size_t)h.nurseryUsed << 2, sum);
+    for (int t = 0; t < SLAB_CLASSES; t++) {
+        sum = checksum(slabClasses[t].partial.data(), h.slabPartial[t] * sizeof(int), sum);
+    }
+    h.checksum = checksum(mem->start, heapBytes, sum);
+    try {
+        writeAll(fd, &h, sizeof(h));
+        writeAll(fd, mem->chunks.data(), h.chunkCount * sizeof(HeapChunk));
+        for (int i = 0; i < h.symCapacity; i += SYM_SEGMENT_SIZE) {
+            writeAll(fd, &symTable->at(i), (size_t)min(SYM_SEGMENT_SIZE, h.symCapacity - i) * sizeof(Symbol));
+        }
+        writeAll(fd, nurseryFrom, (size_t)h.nurseryUsed << 2);
+        for (int t = 0; t < SLAB_CLASSES; t++) {
+            writeAll(fd, slabClasses[t].partial.data(), h.slabPartial[t] * sizeof(int));
+        }
+        if (lseek(fd, h.heapOffset, SEEK_SET) == -1)
+            throw std::runtime_error("Error writing snapshot");
+        writeAll(fd, mem->start, heapBytes);
+        if (ftruncate(fd, h.heapOffset + (heapBytes + page - 1) / page * page) != 0 || fsync(fd) != 0)
+            throw std::runtime_error("Error writing snapshot");
+    } catch (std::runtime_error& e) {
+        endCompactEpoch();
+        resumeWorld();
+        PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
+        PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+        close(fd);
+        unlink(tmp.c_str());
+        throw;
+    }
+    endCompactEpoch();
+    resumeWorld();
     PTHREAD_MUTEX_UNLOCK(&symTable->mutex);
     PTHREAD_MUTEX_UNLOCK(&mem->mutex);
+    close(fd);
+    if (rename(tmp.c_str(), path) != 0)
+        throw std::runtime_error("Error writing snapshot");
+    LOG("snapshotMem", _COLOR_BLUE, "Wrote snapshot of %ld bytes of heap\n", (long)heapBytes);
 }
 
-void handlSigUSR1(int sig) {
-    gc_run();
-}
-void handleSigUSR2(int sig) {
-    pthread_exit(0);
-}
-
-void* garbageCollector(void*) {
-    signal(SIGUSR1, handlSigUSR1);
-    signal(SIGUSR2, handleSigUSR2);
-    sem_post(&sem_gc);
-    sigset_t set;
-    sigemptyset(&set);
-    sigaddset(&set, SIGUSR1);
-    while (true) {
-        usleep(GC_PERIOD_US);
-        pthread_sigmask(SIG_BLOCK, &set, NULL);
-        gc_run();
-        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+/**
+ * @brief Creates the memory from a snapshot written by snapshotMem. The heap is
+ *        mapped copy-on-write from the file, so pages are only read as they are
+ *        touched (and once by the checksum). Variables keep their addresses;
+ *        variables that were in scope are not in any scope of the new process
+ *        and live until they are freed with freeElem.
+ *
+ * @param path: snapshot file
+ * @param gc: if true, garbage collector is created
+ * @param compactThreads: number of threads a full compaction runs on
+ * @return ArrPtr: the root given to snapshotMem, addr is INVALID_HANDLE if there was none
+ */
+ArrPtr restoreMem(const char* path, bool gc, int compactThreads) {
+    if (mem != nullptr)
+        throw std::runtime_error("Memory already created");
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Error opening snapshot file");
+    SnapshotHeader h;
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    if (!readAll(fd, &h, sizeof(h)) || memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION ||
+        fstat(fd, &st) != 0 || h.heapOffset % page != 0 || st.st_size < h.heapOffset + ((long long)h.heapWords << 2)) {
+        close(fd);
+        throw std::runtime_error("Invalid snapshot file");
     }
-    pthread_exit(0);
-}
-
-void gcActivate() {
-    LOG("Garbage Collector", _COLOR_GREEN, "Signalled garbage collector\n");
-    if (gc_active)
-        pthread_kill(gcThread, SIGUSR1);
+    // the header is only covered by the checksum once everything is read, sizes that
+    // drive the reads and allocations below are bounded first
+    if (h.heapWords <= 0 || h.heapWords > (INT_MAX >> 2) || h.limitBytes < (h.heapWords << 2) ||
+        h.nurseryWords < 0 || h.nurseryWords > (INT_MAX >> 3) || h.nurseryUsed < 0 || h.nurseryUsed > h.nurseryWords ||
+        (h.nurseryActive != 0 && h.nurseryActive != 1) || h.pageMode < SMALL_PAGES || h.pageMode > HUGETLB_PAGES ||
+        h.chunkCount <= 0 || h.chunkCount > h.heapWords / MIN_BLOCK_WORDS ||
+        h.symCapacity <= 0 || h.symCapacity > SYM_MAX_ENTRIES || h.symSize < 0 || h.symSize > h.symCapacity) {
+        close(fd);
+        throw std::runtime_error("Corrupt snapshot file");
+    }
+    for (int t = 0; t < SLAB_CLASSES; t++) {
+        if (h.slabPartial[t] < 0 || h.slabPartial[t] > h.symCapacity) {
+            close(fd);
+            throw std::runtime_error("Corrupt snapshot file");
+        }
+    }
+    vector<HeapChunk> chunks(h.chunkCount);
+    // the reserved range is passed as the maximum so that limit (and the nursery
+    // after it) lands where it was, whatever page size the mapping falls back to
+    try {
+        initMem(h.heapWords << 2, h.nurseryWords, h.limitBytes, h.symCapacity, (PageMode)h.pageMode);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    if ((mem->limit - mem->start) << 2 != h.limitBytes || (nursery != nullptr && nursery->base[0] != h.nurseryBase)) {
+        close(fd);
+        freeMem();
+        throw std::runtime_error("Snapshot heap layout can't be reproduced");
+    }
+    size_t heapBytes = (size_t)h.heapWords << 2;
+    int* nurseryTo = nursery != nullptr ? mem->start + nursery->base[h.nurseryActive] : nullptr;
+    bool ok = symTable->capacity == h.symCapacity && readAll(fd, chunks.data(), h.chunkCount * sizeof(HeapChunk));
+    for (int i = 0; ok && i < h.symCapacity; i += SYM_SEGMENT_SIZE) {
+        ok = readAll(fd, &symTable->at(i), (size_t)min(SYM_SEGMENT_SIZE, h.symCapacity - i) * sizeof(Symbol));
+    }
+    ok = ok && (h.nurseryUsed == 0 || (nurseryTo != nullptr && readAll(fd, nurseryTo, (size_t)h.nurseryUsed << 2)));
+    for (int t = 0; ok && t < SLAB_CLASSES; t++) {
+        slabClasses[t].partial.resize(h.slabPartial[t]);
+        ok = readAll(fd, slabClasses[t].partial.data(), h.slabPartial[t] * sizeof(int));
+    }
+    ok = ok && mmap(mem->start, (heapBytes + page - 1) / page * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, h.heapOffset) != MAP_FAILED;
+    close(fd);
+    if (ok) {
+        unsigned long long expected = h.checksum;
+        h.checksum = 0;
+        unsigned long long sum = checksum(&h, sizeof(h), 0);
+        sum = checksum(chunks.data(), h.chunkCount * sizeof(HeapChunk), sum);
+        for (int i = 0; i < h.symCapacity; i += SYM_SEGMENT_SIZE) {
+            sum = checksum(&symTable->at(i), (size_t)min(SYM_SEGMENT_SIZE, h.symCapacity - i) * sizeof(Symbol), sum);
+        }
+        sum = checksum(nurseryTo, (size_t)h.nurseryUsed << 2, sum);
+        for (int t = 0; t < SLAB_CLASSES; t++) {
+            sum = checksum(slabClasses[t].partial.data(), h.slabPartial[t] * sizeof(int), sum);
+        }
+        ok = checksum(mem->start, heapBytes, sum) == expected;
+    }
+    if (!ok) {
+        freeMem();
+        throw std::runtime_error("Corrupt snapshot file");
+    }
+    mem->growable = h.growable;
+    mem->chunks = chunks;
+    mem->flBitmap = h.flBitmap;
+    memcpy(mem->slBitmap, h.slBitmap, sizeof(h.slBitmap));
+    memcpy(mem->freeLists, h.freeLists, sizeof(h.freeLists));
+    mem->tinyList = h.tinyList;
+    mem->tinyCount = h.tinyCount;
+    mem->totalFreeMem = h.totalFreeMem;
+    mem->totalFreeBlocks = h.totalFreeBlocks;
+    mem->biggestFreeBlockSize = h.biggestFreeBlockSize;
+    symTable->size = h.symSize;
+    symTable->freeTop = h.freeTop;
+    if (nursery != nullptr) {
+        nursery->active = h.nurseryActive;
+        nursery->top = h.nurseryTop;
+    }
+    // variables that went out of scope while pinned were not swept, pins of
+    // the old process are gone
+    for (int i = 0; i < symTable->capacity; i++) {
+        symTable->at(i).pins = 0;
+        if (symTable->isAllocated(i) && !symTable->isMarked(i)) {
+            orphanGarbage.push_back(i);
+            pendingGarbage++;
+        }
+    }
+    startCollector(gc, compactThreads);
+    LOG("restoreMem", _COLOR_BLUE, "Restored snapshot of %ld bytes of heap\n", (long)heapBytes);
+    return ArrPtr(h.rootType, h.rootAddr, h.rootWidth);
 }
 
 void testMemBlock() {
@@ -985,20 +3948,36 @@ void testAssignVar() {
 }
 
 void freeMem() {
-    PTHREAD_MUTEX_LOCK(&mem->mutex);
-    PTHREAD_MUTEX_LOCK(&symTable->mutex);
     if (gc_active) {
-        pthread_kill(gcThread, SIGUSR2);
+        gcSched->shutdown();  // a running cycle completes first
         pthread_join(gcThread, nullptr);
         gc_active = false;
-        sem_destroy(&sem_gc);
     }
+    PTHREAD_MUTEX_LOCK(&mem->mutex);
+    PTHREAD_MUTEX_LOCK(&symTable->mutex);
+    stopWorld();
+    for (ThreadCache* tc = caches; tc != nullptr; tc = tc->next) {
+        tc->cur = tc->end = tc->symCount = 0;
+        delete tc->stack;
+        tc->stack = nullptr;
+        tc->garbage.clear();
+    }
+    orphanGarbage.clear();
+    pendingGarbage = compactPending = compactActive = 0;
+    compactQueue.clear();
+    compactNext = 0;
+    resumeWorld();
     delete mem;
     delete symTable;
-    delete stack;
+    delete nursery;
+    delete compactPool;
+    delete gcSched;
     mem = NULL;
     symTable = NULL;
-    stack = NULL;
+    nursery = NULL;
+    compactPool = NULL;
+    gcSched = NULL;
+    regions.clear();
 #ifdef GC_LOG
     fclose(logfile);
 #endif
@@ -1044,11 +4023,11 @@ void testCompaction() {
     // freeElem(arr1);
     freeElem(p4);
     compactMem();
-    int* arrptr1 = symTable->getPtr(arr1.addr >> 2);
+    int* arrptr1 = symTable->getPtr(HANDLE_IDX(arr1.addr));
     cout << "arrptr1: " << arrptr1 - mem->start << endl;
-    int* ptr3 = symTable->getPtr(p3.addr >> 2);
+    int* ptr3 = symTable->getPtr(HANDLE_IDX(p3.addr));
     cout << "ptr3:" << ptr3 - mem->start << endl;
-    int* arrptr2 = symTable->getPtr(arr2.addr >> 2);
+    int* arrptr2 = symTable->getPtr(HANDLE_IDX(arr2.addr));
     cout << "arrptr2: " << arrptr2 - mem->start << endl;
     cout << endl;
     int* p = mem->start;
@@ -1079,17 +4058,17 @@ void testCompactionCall() {
     ArrPtr arr3 = createArr(Type::INT, 6);
     usleep(200 * 1000);
     // gc_run();
-    int* ptr1 = symTable->getPtr(p1.addr >> 2);
+    int* ptr1 = symTable->getPtr(HANDLE_IDX(p1.addr));
     cout << "ptr1:" << ptr1 - mem->start << endl;
-    int* ptr2 = symTable->getPtr(p2.addr >> 2);
+    int* ptr2 = symTable->getPtr(HANDLE_IDX(p2.addr));
     cout << "ptr2:" << ptr2 - mem->start << endl;
-    int* ptr3 = symTable->getPtr(p3.addr >> 2);
+    int* ptr3 = symTable->getPtr(HANDLE_IDX(p3.addr));
     cout << "ptr3:" << ptr3 - mem->start << endl;
-    int* ptr4 = symTable->getPtr(p4.addr >> 2);
+    int* ptr4 = symTable->getPtr(HANDLE_IDX(p4.addr));
     cout << "ptr4:" << ptr4 - mem->start << endl;
-    int* arrptr2 = symTable->getPtr(arr2.addr >> 2);
+    int* arrptr2 = symTable->getPtr(HANDLE_IDX(arr2.addr));
     cout << "arrptr2: " << arrptr2 - mem->start << endl;
-    int* arrptr3 = symTable->getPtr(arr3.addr >> 2);
+    int* arrptr3 = symTable->getPtr(HANDLE_IDX(arr3.addr));
     cout << "arrptr3: " << arrptr3 - mem->start << endl;
     cout << "Total free memory: " << mem->totalFreeMem << endl;
     cout << "Total free blocks: " << mem->totalFreeBlocks << endl;
@@ -1099,6 +4078,45 @@ void testCompactionCall() {
     freeMem();
 }
 
+// snapshot round trips over heaps with and without a nursery and with huge pages,
+// the heap size is not a multiple of a huge page so the layout depends on the page size
+void testSnapshot() {
+    const char* path = "memlab_test.snap";
+    PageMode modes[] = {SMALL_PAGES, TRANSPARENT_HUGE_PAGES, HUGETLB_PAGES};
+    for (PageMode pages : modes) {
+        for (int generational = 0; generational < 2; generational++) {
+            createMem(3000000 + 12345, false, generational, 1, 0, pages);
+            initScope();
+            ArrPtr small = createArr(Type::INT, 100);  // in the nursery when generational
+            ArrPtr big = createArr(Type::INT, 100000);
+            Ptr v = createVar(Type::MEDIUM_INT);
+            iotaArr(small, 0, 0, 100);
+            iotaArr(big, 7, 0, 100000);
+            assignVar(v, medium_int(-42));
+            ArrPtr dir = createArr(Type::INT, 6);
+            int handles[6] = {(int)HANDLE_IDX(small.addr), (int)HANDLE_GEN(small.addr), (int)HANDLE_IDX(big.addr),
+                              (int)HANDLE_GEN(big.addr), (int)HANDLE_IDX(v.addr), (int)HANDLE_GEN(v.addr)};
+            assignArr(dir, handles, 6);
+            snapshotMem(path, &dir);
+            endScope();
+            freeMem();
+            ArrPtr root = restoreMem(path, false);
+            getArr(root, 0, 6, handles);
+            small = ArrPtr(Type::INT, HANDLE(handles[1], handles[0]), 100);
+            big = ArrPtr(Type::INT, HANDLE(handles[3], handles[2]), 100000);
+            v = Ptr(Type::MEDIUM_INT, HANDLE(handles[5], handles[4]));
+            int a, b;
+            medium_int m;
+            getVar(small, 42, &a);
+            getVar(big, 99999, &b);
+            getVar(v, &m);
+            cout << pageModeName(pages) << (generational ? ", nursery: " : ": ") << (a == 42 && b == 100006 && m.to_int() == -42 ? "ok" : "FAILED") << endl;
+            freeMem();
+        }
+    }
+    unlink(path);
+}
+
 void testAssignArr() {
     createMem(1024 * 1024 * 512);  // 512 MB
     initScope();
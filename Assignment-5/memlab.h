@@ -16,11 +16,54 @@
 #include "debug.h"
 #include "medium_int.h"
 
-#define GC_PERIOD_US 20
+#define GC_PERIOD_US 20  // minimum gap between two background collection cycles
+#define GC_BUDGET_SHIFT 4       // the initial allocation budget is 1/16 of the heap
+#define GC_MIN_BUDGET_SHIFT 8   // the budget adapts between 1/256
+#define GC_MAX_BUDGET_SHIFT 1   // and 1/2 of the heap
+#define GC_WATERMARK 0.75       // heap occupancy above which any garbage starts a cycle
+#define GC_CPU_FRACTION 0.05    // share of the time the collector aims to take
 #define EFFEC_MEM_RATIO 1.25
 #define INT24_MAX 0x7fffff
 #define INT24_MIN -0x800000
 #define COMPACT_THRESHOLD 3.1
+#define COMPACT_STEP_US 500               // default time budget of an incremental compaction step
+#define COMPACT_STEP_BYTES (1024 * 1024)  // default bytes moved by an incremental compaction step
+#define COMPACT_REGIONS_PER_THREAD 4        // regions per compaction thread, for load balancing
+#define COMPACT_REGION_MIN_WORDS (1 << 16)  // smaller regions are not worth a thread
+#define COMPACT_SYMBOL_CHUNK 4096           // symbol table entries updated per task
+#define MIN_BLOCK_WORDS 3  // header + 1 word payload + footer
+#define MIN_LIST_WORDS 4   // header + next + prev + footer
+#define TINY_FOOTER(prev) (~(((prev) + 1) << 1))  // footer of a tiny free block, odd and negative
+#define TINY_PREV(footer) ((~(footer) >> 1) - 1)
+#define IS_TINY_FOOTER(footer) ((footer) < 0)
+#define HEAP_GROW_MIN_BYTES (1 << 20)  // smallest chunk a growable heap adds
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define SNAPSHOT_MAGIC "MEMLABSN"
+#define SNAPSHOT_VERSION 6
+#define HEAP_RELEASE_MIN_BYTES (64 * 1024)      // free blocks whose pages go back to the OS after compaction
+#define HEAP_RELEASE_ADVICE MADV_DONTNEED       // MADV_FREE releases lazily, RSS only drops under memory pressure
+#define FL_COUNT 32        // first level size classes (powers of two)
+#define SL_BITS 2
+#define SL_COUNT (1 << SL_BITS)  // second level size classes per power of two
+#define TLAB_SIZE (64 * 1024)      // bytes carved out of the heap for a thread allocation buffer
+#define TLAB_MIN_WORDS 256         // heaps that can't fit 64 such buffers don't use them
+#define TLAB_SYMBOLS 64            // symbol table entries a thread reserves at a time
+#define NURSERY_SHIFT 3            // each nursery semispace takes 1/8 of the heap in generational mode
+#define NURSERY_AGE_BITS 4         // low bits of a nursery block footer count the minor collections survived
+#define NURSERY_FILLER -1          // footer of a nursery block that holds no object
+#define PROMOTE_AGE 2              // minor collections survived before an object moves to the old generation
+#define SYM_SEGMENT_SHIFT 12       // the symbol table grows by segments of 4096 entries
+#define SYM_SEGMENT_SIZE (1 << SYM_SEGMENT_SHIFT)
+#define SYM_MAX_ENTRIES (1 << 26)  // nursery footers keep the owner index above NURSERY_AGE_BITS
+#define SCOPE_STACK_SIZE 1024      // initial entries of a scope stack, doubles when full
+#define HANDLE(gen, idx) (((Handle)(gen) << 32) | (unsigned int)(idx))
+#define HANDLE_IDX(h) ((unsigned int)(h))
+#define HANDLE_GEN(h) ((unsigned int)((h) >> 32))
+#define INVALID_HANDLE (~0ULL)  // scope marker, addr of a missing snapshot root
+#define SYM_SLOT 0x80000000u       // word1 flag of a scalar kept in a slab slot
+#define SLAB_BYTES 4096            // payload of a slab of scalar variables
+#define SLAB_CLASSES 4             // INT, CHAR, MEDIUM_INT and BOOL slabs
+#define SLAB_MIN_HEAP 64           // heaps that can't fit 64 slabs keep scalars in their own blocks
 
 enum Type {
     INT,
@@ -30,72 +73,367 @@ enum Type {
     ARRAY
 };
 
+// Header words of a slab payload, the occupancy bitmap (one bit per slot) and the
+// slots follow it. hint is the first bitmap word that may have a free slot.
+enum SlabField {
+    SLAB_TYPE,
+    SLAB_USED,
+    SLAB_POS,  // index in the partial list of the class, -1 if full
+    SLAB_HINT,
+    SLAB_HEADER_WORDS
+};
+
+// Pages backing the heap, in order of preference when falling back
+enum PageMode {
+    SMALL_PAGES,
+    TRANSPARENT_HUGE_PAGES,  // 2MB aligned mapping advised with MADV_HUGEPAGE
+    HUGETLB_PAGES            // MAP_HUGETLB, needs preallocated pages (vm.nr_hugepages)
+};
+
+// Symbol table index in the low 32 bits, generation of the entry in the high 32 bits.
+// Freeing an entry bumps its generation, so handles kept after a free no longer match.
+typedef unsigned long long Handle;
+
 struct Ptr {
     Type type;
-    int addr;
-    Ptr(const Type& _t, int _addr) : type(_t), addr(_addr) {}
+    Handle addr;
+    Ptr(const Type& _t, Handle _addr) : type(_t), addr(_addr) {}
 };
 
 struct ArrPtr : public Ptr {
     int width;
-    ArrPtr(const Type& t, int _addr, int _width) : Ptr(t, _addr), width(_width) {}
+    ArrPtr(const Type& t, Handle _addr, int _width) : Ptr(t, _addr), width(_width) {}
+};
+
+// View of the payload of a pinned array (see pinArr()), data stays valid
+// until the array is unpinned since pinned blocks are never moved
+template <typename T>
+struct ArrView {
+    T* data;
+    int width;
+    ArrView(T* _data = nullptr, int _width = 0) : data(_data), width(_width) {}
+    T& operator[](int i) const { return data[i]; }
+    T* begin() const { return data; }
+    T* end() const { return data + width; }
 };
 
 // valid, mark bit fields are stored as LSB's
 struct Symbol {
-    // word1 -> 31 bits for wordIdx, 1 bit for if symbol is allocated in symboltable memory
-    // word2 -> 31 bits for offset, 1 bit for if symbol is in use (mark for garbage collection)
+    // word1 -> 31 bits for wordIdx, 1 bit for if symbol is allocated in symboltable memory,
+    //          scalars in a slab hold SYM_SLOT and the symbol of the slab instead of wordIdx
+    // word2 -> 31 bits for offset, 1 bit for if symbol is in use (mark for garbage collection),
+    //          the offset of a BOOL slot counts bits
     unsigned int word1, word2;
+    unsigned int gen;      // bumped every time the entry is freed (past the renewed handles)
+    unsigned int pins;     // pin count, pinned blocks are never moved or collected
+    unsigned int renewed;  // renew() count since the entry was allocated, handles carry gen + renewed
 };
 
+// Entries live in segments of SYM_SEGMENT_SIZE that are added as the table runs
+// full (up to maxCapacity) and never move, so entries can be read without a lock
+// while the table grows. capacity is published after the segment is in place.
+// free entries form a lock-free (Treiber) stack linked through word2 (next index + 1),
+// freeTop packs an ABA tag in the upper 32 bits with the top index + 1 (0 if empty)
 struct SymbolTable {
-    unsigned int head, tail;
-    Symbol* symbols;
+    unsigned long long freeTop;
+    Symbol** segments;
     int size;
     int capacity;
-    pthread_mutex_t mutex;
-    SymbolTable(int _size);
+    int maxCapacity;
+    pthread_mutex_t mutex;  // only held by the collector while scanning or rewriting the whole table
+    pthread_mutex_t growMutex;  // serializes grow()
+    SymbolTable(int _size, int _maxCapacity = 0);
     ~SymbolTable();
     int alloc(unsigned int wordidx, unsigned int offset);
+    void assign(unsigned int idx, unsigned int wordidx, unsigned int offset);
+    void assignSlot(unsigned int idx, unsigned int slab, unsigned int offset);
+    int reserve(int n, int* out);
+    void unreserve(unsigned int idx);
     void free(unsigned int idx);
-    inline int getWordIdx(unsigned int idx) { return symbols[idx].word1 >> 1; }
-    inline int getOffset(unsigned int idx) { return symbols[idx].word2 >> 1; }
-    inline void setMarked(unsigned int idx) { symbols[idx].word2 |= 1; }     // mark as in use
-    inline void setUnmarked(unsigned int idx) { symbols[idx].word2 &= -2; }  // mark as free
-    inline void setAllocated(unsigned int idx) { symbols[idx].word1 |= 1; }  // mark as allocated
-    inline void setUnallocated(unsigned int idx) { symbols[idx].word1 &= -2; }
-    inline bool isMarked(unsigned int idx) { return symbols[idx].word2 & 1; }
-    inline bool isAllocated(unsigned int idx) { return symbols[idx].word1 & 1; }
+    int pop();
+    void push(unsigned int idx);
+    bool addSegment();
+    bool grow();
+    inline Symbol& at(unsigned int idx) { return segments[idx >> SYM_SEGMENT_SHIFT][idx & (SYM_SEGMENT_SIZE - 1)]; }
+    inline Handle handle(unsigned int idx) { return HANDLE(at(idx).gen + at(idx).renewed, idx); }
+    // index of the entry h refers to, -1 if h is out of range or stale
+    inline int lookup(Handle h) {
+        unsigned int idx = HANDLE_IDX(h);
+        if (idx >= (unsigned int)__atomic_load_n(&capacity, __ATOMIC_ACQUIRE))
+            return -1;
+        // renewed first: push() resets it after moving gen on, so a new count comes with the new gen
+        unsigned int renewed = __atomic_load_n(&at(idx).renewed, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&at(idx).gen, __ATOMIC_ACQUIRE) + renewed != HANDLE_GEN(h))
+            return -1;
+        return idx;
+    }
+    // like lookup, but only compares the free generation: scope stacks keep the handle
+    // of the creation, which stays valid across renew()
+    inline int lookupScoped(Handle h) {
+        unsigned int idx = HANDLE_IDX(h);
+        if (idx >= (unsigned int)__atomic_load_n(&capacity, __ATOMIC_ACQUIRE) ||
+            __atomic_load_n(&at(idx).gen, __ATOMIC_ACQUIRE) != HANDLE_GEN(h))
+            return -1;
+        return idx;
+    }
+    // gives a live entry a new handle so that the old ones fail lookup, mem->mutex must be held
+    inline Handle renew(unsigned int idx) {
+        __atomic_add_fetch(&at(idx).renewed, 1, __ATOMIC_RELEASE);
+        return handle(idx);
+    }
+    inline bool isSlot(unsigned int idx) { return at(idx).word1 & SYM_SLOT; }
+    inline int getSlab(unsigned int idx) { return (at(idx).word1 & ~SYM_SLOT) >> 1; }
+    // word offset of the block, the slab block for a slot
+    inline int getWordIdx(unsigned int idx) {
+        unsigned int w = at(idx).word1;
+        return (w & SYM_SLOT ? at((w & ~SYM_SLOT) >> 1).word1 : w) >> 1;
+    }
+    inline int getOffset(unsigned int idx) { return at(idx).word2 >> 1; }
+    inline void setMarked(unsigned int idx) { __atomic_fetch_or(&at(idx).word2, 1, __ATOMIC_RELAXED); }     // mark as in use
+    inline void setUnmarked(unsigned int idx) { __atomic_fetch_and(&at(idx).word2, -2, __ATOMIC_RELAXED); }  // mark as free
+    inline void setAllocated(unsigned int idx) { __atomic_fetch_or(&at(idx).word1, 1, __ATOMIC_RELAXED); }  // mark as allocated
+    inline void setUnallocated(unsigned int idx) { __atomic_fetch_and(&at(idx).word1, -2, __ATOMIC_RELAXED); }
+    inline bool isMarked(unsigned int idx) { return __atomic_load_n(&at(idx).word2, __ATOMIC_RELAXED) & 1; }
+    inline bool isAllocated(unsigned int idx) { return __atomic_load_n(&at(idx).word1, __ATOMIC_RELAXED) & 1; }
+    inline void pin(unsigned int idx) { __atomic_add_fetch(&at(idx).pins, 1, __ATOMIC_SEQ_CST); }
+    inline bool isPinned(unsigned int idx) { return __atomic_load_n(&at(idx).pins, __ATOMIC_SEQ_CST) != 0; }
+    bool unpin(unsigned int idx);
     int* getPtr(unsigned int idx);
 };
 
+// Scope stack of handles, INVALID_HANDLE marks the start of a scope
 struct Stack {
     int _top;
-    int* _elems;
+    Handle* _elems;
     int capacity;
     Stack(int size);
     ~Stack();
-    void push(int elem);
-    int pop();
-    int top();
+    void push(Handle elem);
+    Handle pop();
+    Handle top();
+};
+
+// Scalar variables of a type are packed in slots of slabs, SLAB_BYTES heap objects
+// owned by an internal symbol that never goes out of scope, so the collector moves
+// slabs like any other block. A scalar's symbol refers to the slab's symbol. Slabs
+// with free slots are kept on the partial list of their class, an empty slab is
+// freed unless it is the last one on the list. Guarded by slabMutex.
+struct SlabClass {
+    int slotBits;     // bits per slot
+    int slots;        // slots per slab
+    int bitmapWords;  // words of the occupancy bitmap
+    std::vector<int> partial;  // symbols of the slabs with free slots
+    void init(int bits);
+    inline int dataWord() { return SLAB_HEADER_WORDS + bitmapWords; }
+    // offset of a slot from the start of the slab payload, in bits for BOOL slots and bytes otherwise
+    inline int slotOffset(int slot) { return slotBits == 1 ? (dataWord() << 5) + slot : (dataWord() << 2) + slot * (slotBits >> 3); }
+    inline int slotOf(int offset) { return slotBits == 1 ? offset - (dataWord() << 5) : (offset - (dataWord() << 2)) / (slotBits >> 3); }
 };
 
+// Committed extent [begin, end) of the heap (word offsets), freeWords counts its free blocks
+struct HeapChunk {
+    int begin, end;
+    int freeWords;
+};
+
+// free blocks of >= MIN_LIST_WORDS words are kept in segregated doubly linked lists,
+// next/prev (word offsets, -1 for null) are stored in the first two payload words.
+// 3 word free blocks can't hold both links, so they are kept on a tiny list and
+// stay tagged as allocated. Their next link is in the payload word and their prev
+// link in the footer, encoded as a negative number to tell them apart from
+// allocated blocks (see TINY_FOOTER), freeBlock coalesces with them like with
+// other free blocks.
+// The heap is a reserved address range [start, limit) committed in chunks as it
+// grows, chunks of a growable heap end with an allocated fencepost block. The
+// pages of large free blocks are released to the OS after compaction.
 struct MemBlock {
     int *start, *end;
+    int* limit;       // end of the reserved range the heap can grow into
+    size_t reserved;  // bytes reserved, the nursery included
+    bool growable;
+    PageMode pageMode;  // pages obtained
+    size_t pageBytes;   // granularity of commits and releases
+    std::vector<HeapChunk> chunks;
     int* mem;
     int totalFreeMem;
     int totalFreeBlocks;
     int biggestFreeBlockSize;
+    unsigned int flBitmap;               // bit i set if any list in first level i is non-empty
+    unsigned int slBitmap[FL_COUNT];     // bit j set if list (i, j) is non-empty
+    int freeLists[FL_COUNT * SL_COUNT];  // heads of the segregated free lists
+    int tinyList;
+    int tinyCount;
     pthread_mutex_t mutex;
-    void Init(int _size);
+    void Init(int _size, int _extra = 0, int _max = 0, PageMode _pages = SMALL_PAGES);
     ~MemBlock();
     int getMem(int size);
     void splitBlock(int* ptr, int size);
     void freeBlock(int wordid);
+    bool extendBlock(int wordid, int words);
+    void shrinkBlock(int wordid, int words);
+    void insertFree(int* ptr);
+    void removeFree(int* ptr);
+    void removeTiny(int* ptr);
+    int* findFree(int words);
+    void resetFreeLists();
+    void updateBiggest();
+    void* reserve(size_t bytes);
+    void commit(int* from, int* to);
+    bool addChunk(int words);
+    bool grow(int words);
+    long releaseFree();
+    HeapChunk& chunkOf(int wordid);
+};
+
+// Bump-pointer nursery of the generational mode: two semispaces of words words
+// right after the old generation [mem->start, mem->end), addressed by the same
+// word offsets. Allocation buffers are carved from the active semispace, a minor
+// collection copies the survivors to the other one (or promotes them to the old
+// generation) and flips the two. Nursery blocks keep the header of heap blocks,
+// the footer holds the owner symbol and age (or NURSERY_FILLER).
+struct Nursery {
+    int base[2];
+    int words;
+    int active;
+    int top;  // bump pointer in the active semispace
+    Nursery(int _base, int _words);
+    int take(int n);
+    void fill(int wordid, int n);
+    inline bool contains(int wordid) { return wordid >= base[0]; }
+};
+
+// Heap region of the parallel compactor: [begin, end) is block aligned. The
+// summary (live words, pinned blocks) gives the prefix sum destIn, the word
+// offset the region slides to. progress is the source offset below which all
+// blocks of the region have been moved, regions writing below it wait on it.
+struct CompactRegion {
+    int begin, end;
+    int live;          // words of the blocks that move
+    int pinEnd;        // end of the last pinned block, -1 if none
+    int liveAfterPin;  // live words after the last pinned block
+    int destIn;
+    int progress;
+    std::vector<std::pair<int, int>> gaps;  // (offset, words) of free blocks left in front of pinned blocks
+};
+
+// Worker threads of the parallel compactor, they sleep on a barrier between tasks.
+// The calling thread takes part in every task as worker 0.
+struct CompactPool {
+    int nthreads;
+    pthread_t* threads;
+    pthread_barrier_t start, done;
+    void (*task)();
+    bool stop;
+    CompactPool(int _nthreads);
+    ~CompactPool();
+    void run(void (*_task)());
+};
+
+// Timings of the collection cycles run by the garbage collector thread
+struct GcStats {
+    unsigned long cycles;
+    long long lastCycleNs;
+    long long maxCycleNs;
+    long long totalCycleNs;
+};
+
+// Decides when the garbage collector thread runs a background cycle: once the
+// bytes allocated (counted per allocation buffer or large block) or released by
+// endScope and freeElem since the last cycle reach the budget, or once the heap
+// is filled past the watermark while there is garbage. The budget doubles or
+// halves after each cycle to keep the collector near target of the time.
+struct GcPacer {
+    long long allocated, released;  // bytes since the last cycle
+    long long budget, minBudget, maxBudget;
+    long long heap;  // bytes of the old generation
+    double watermark = GC_WATERMARK;
+    double target = GC_CPU_FRACTION;
+    void init(long long heapBytes);
+    void resize(long long heapBytes);
+    bool due();
+    void adapt(long long cycleNs, long long periodNs);
+};
+
+// Schedules the garbage collector thread: it sleeps on a condition variable until
+// gcActivate asks for a cycle (requests are numbered, completed is the last one
+// served) or until the pacer asks for a background cycle, mutators announce
+// new work with notify(). Background cycles are at least GC_PERIOD_US apart.
+struct GcScheduler {
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;  // collector waits for requests and work
+    pthread_cond_t done;  // callers wait for completed cycles
+    unsigned long requested, completed;
+    int idle;  // set while the collector waits without a timeout
+    bool stop;
+    long long nextRunNs;  // earliest start of the next background cycle
+    long long lastEndNs;  // end of the last cycle
+    GcStats stats;
+    GcScheduler();
+    ~GcScheduler();
+    void notify();
+    void request(bool wait);
+    void shutdown();
+    bool next(unsigned long* seq);
+    void complete(unsigned long seq, long long ns);
+};
+
+// Header of a snapshot file (see snapshotMem()), followed by the heap chunks, the
+// symbol table, the used part of the active nursery semispace and the partial slab lists. The heap words
+// start at the page aligned heapOffset. checksum covers all of it (with the
+// checksum field zeroed).
+struct SnapshotHeader {
+    char magic[8];
+    unsigned int version;
+    int heapWords;
+    int limitBytes;  // reserved heap (start to limit), the nursery follows it
+    int growable;
+    int pageMode;
+    int nurseryBase;  // word offset of the nursery, restoreMem rejects the file if it moves
+    int chunkCount;
+    unsigned int flBitmap;
+    unsigned int slBitmap[FL_COUNT];
+    int freeLists[FL_COUNT * SL_COUNT];
+    int tinyList, tinyCount;
+    int totalFreeMem, totalFreeBlocks, biggestFreeBlockSize;
+    int symCapacity, symSize;
+    unsigned long long freeTop;
+    int nurseryWords, nurseryActive, nurseryTop, nurseryUsed;
+    Type rootType;
+    Handle rootAddr;
+    int rootWidth;
+    int slabPartial[SLAB_CLASSES];  // symbols of the partial slabs, after the nursery words
+    long long heapOffset;
+    unsigned long long checksum;
+};
+
+// Per-thread allocation buffer: [cur, end) is a word range of the heap tagged as a
+// single allocated block, small objects are bump allocated from its front. Symbol
+// table entries are reserved in batches too. The mutex is private to the owning
+// thread and is only contended by the garbage collector (see stopWorld()).
+// Each thread also keeps its own scope stack, only touched by that thread.
+// inAccess is set while the thread is inside a lock-free accessor (see enterAccess()).
+// garbage holds the symbols the thread's endScope unmarked, swept by the next gc_run.
+struct ThreadCache {
+    int cur, end;
+    int symbols[TLAB_SYMBOLS];
+    int symCount;
+    Stack* stack;
+    std::vector<int> garbage;
+    int inAccess;
+    pthread_mutex_t mutex;
+    ThreadCache* next;
+    ThreadCache();
+    ~ThreadCache();
+    int bump(int words);
+    void refill();
+    void retire();
+    void releaseSymbols();
+    void dropScopes();
 };
 
 int getSize(const Type& type);
-void createMem(int size, bool gc = true);
+void createMem(int size, bool gc = true, bool generational = false, int compactThreads = 1, int maxSize = 0,
+               PageMode pages = SMALL_PAGES);
 Ptr createVar(const Type& t);
 void getVar(const Ptr& p, void* val);
 void assignVar(const Ptr& p, int val);
@@ -115,12 +453,57 @@ void assignArr(const ArrPtr& p, int arr[], int n);
 void assignArr(const ArrPtr& p, medium_int arr[], int n);
 void assignArr(const ArrPtr& p, char arr[], int n);
 void assignArr(const ArrPtr& p, bool arr[], int n);
+void fillArr(const ArrPtr& p, int val, int start, int n);
+void fillArr(const ArrPtr& p, medium_int val, int start, int n);
+void fillArr(const ArrPtr& p, char c, int start, int n);
+void fillArr(const ArrPtr& p, bool f, int start, int n);
+void iotaArr(const ArrPtr& p, int val, int start, int n);
+void iotaArr(const ArrPtr& p, medium_int val, int start, int n);
+void iotaArr(const ArrPtr& p, char c, int start, int n);
+long long sumArr(const ArrPtr& p, int start, int n);
+int minArr(const ArrPtr& p, int start, int n);
+int maxArr(const ArrPtr& p, int start, int n);
+int countEqArr(const ArrPtr& p, int val, int start, int n);
+int popcountArr(const ArrPtr& p, int start, int n);
+void addArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void subArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void mulArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void scaleArr(const ArrPtr& dst, const ArrPtr& a, int k, int start, int n);
+void axpyArr(const ArrPtr& y, int alpha, const ArrPtr& x, int start, int n);
+void andArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void orArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void xorArr(const ArrPtr& dst, const ArrPtr& a, const ArrPtr& b, int start, int n);
+void notArr(const ArrPtr& dst, const ArrPtr& a, int start, int n);
+int findFirstSet(const ArrPtr& p);
+int findNextSet(const ArrPtr& p, int idx);
+void copyArr(const ArrPtr& dst, int dstStart, const ArrPtr& src, int srcStart, int n);
+ArrPtr sliceArr(const ArrPtr& src, int start, int n);
+void resizeArr(ArrPtr& p, int width);
 
 void getVar(const ArrPtr& p, int idx, void* _mem);
+void getArr(const ArrPtr& p, int start, int count, int out[]);
+void getArr(const ArrPtr& p, int start, int count, medium_int out[]);
+void getArr(const ArrPtr& p, int start, int count, char out[]);
+void getArr(const ArrPtr& p, int start, int count, bool out[]);
+void pinArr(const ArrPtr& p, ArrView<int>& v);
+void pinArr(const ArrPtr& p, ArrView<medium_int>& v);
+void pinArr(const ArrPtr& p, ArrView<char>& v);
+void pinArr(const ArrPtr& p, ArrView<unsigned int>& v);
+void unpinArr(const ArrPtr& p);
 void freeMem();
-void gcActivate();
+void snapshotMem(const char* path, const ArrPtr* root = nullptr);
+ArrPtr restoreMem(const char* path, bool gc = true, int compactThreads = 1);
+void gcActivate(bool wait = false);
+GcStats gcStats();
+PageMode getPageMode();
+const char* pageModeName(PageMode mode);
+void setGcPacing(int budget, double watermark, double cpuFraction);
 void gc_run();
 void debugPrint(FILE* fp = stdout);
 void compactMem();
+void setCompactBudget(int us, int bytes);
+bool compactStep();
+void beginIncrementalCompaction();
+void minorCollect();
 
 #endif  // _MEM_LAB_H
\ No newline at end of file
@@ -0,0 +1,946 @@
+#include "simd.h"
+
+#include <cstring>
+
+#define MEDIUM_CHUNK 256  // medium ints unpacked at a time by the reductions
+
+#if defined(__x86_64__) && !defined(NO_SIMD)
+#include <immintrin.h>
+#define SIMD_X86
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+
+static bool hasAVX2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+static bool hasSSSE3() {
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+}
+#endif
+
+/**
+ * @brief Replaces the bits of *word selected by mask with bits, atomically
+ */
+static inline void storeMasked(int* word, unsigned int mask, unsigned int bits) {
+    unsigned int old = __atomic_load_n((unsigned int*)word, __ATOMIC_RELAXED);
+    unsigned int val;
+    do {
+        val = (old & ~mask) | (bits & mask);
+    } while (!__atomic_compare_exchange_n((unsigned int*)word, &old, val, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Packs 8 bools (bytes of 0/1) into the bits of a byte, bool j to bit j
+ */
+static inline unsigned int pack8(const bool* src) {
+    unsigned long long x;
+    memcpy(&x, src, 8);
+    return (x * 0x0102040810204080ULL) >> 56;
+}
+
+#ifndef SIMD_X86
+static unsigned int pack32Scalar(const bool* src) {
+    return pack8(src) | (pack8(src + 8) << 8) | (pack8(src + 16) << 16) | (pack8(src + 24) << 24);
+}
+#endif
+
+#ifdef SIMD_X86
+static unsigned int pack32SSE(const bool* src) {
+    // bool 0/1 -> bit 7 of each byte, then gather the sign bits
+    __m128i lo = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)src), 7);
+    __m128i hi = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)(src + 16)), 7);
+    return (unsigned int)_mm_movemask_epi8(lo) | ((unsigned int)_mm_movemask_epi8(hi) << 16);
+}
+
+TARGET_AVX2 static void packWordsAVX2(int* words, const bool* src, int nwords) {
+    for (int w = 0; w < nwords; w++) {
+        __m256i v = _mm256_slli_epi16(_mm256_loadu_si256((const __m256i*)(src + (w << 5))), 7);
+        words[w] = _mm256_movemask_epi8(v);
+    }
+}
+#endif
+
+/**
+ * @brief Packs n bools into the bits [bit, bit + n) of words (bit j of the range
+ *        is bit j % 32 of word j / 32), whole words are packed 32 bools at a time
+ *
+ * @param words: first word of the bit array
+ * @param bit: index of the first bit to write
+ * @param src: bools to pack
+ * @param n: number of bools
+ */
+void packBits(int* words, int bit, const bool* src, int n) {
+    int i = 0;
+    if (bit & 31) {
+        int off = bit & 31;
+        int cnt = n < 32 - off ? n : 32 - off;
+        unsigned int bits = 0;
+        for (int k = 0; k < cnt; k++) {
+            bits |= (unsigned int)src[k] << (off + k);
+        }
+        unsigned int mask = (cnt == 32 ? ~0u : ((1u << cnt) - 1)) << off;
+        storeMasked(words + (bit >> 5), mask, bits);
+        i = cnt;
+    }
+    int* w = words + ((bit + i) >> 5);
+    int nwords = (n - i) >> 5;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        packWordsAVX2(w, src + i, nwords);
+    } else {
+        for (int k = 0; k < nwords; k++) {
+            w[k] = pack32SSE(src + i + (k << 5));
+        }
+    }
+#else
+    for (int k = 0; k < nwords; k++) {
+        w[k] = pack32Scalar(src + i + (k << 5));
+    }
+#endif
+    i += nwords << 5;
+    if (i < n) {
+        int cnt = n - i;
+        unsigned int bits = 0;
+        for (int k = 0; k < cnt; k++) {
+            bits |= (unsigned int)src[i + k] << k;
+        }
+        storeMasked(words + ((bit + i) >> 5), (1u << cnt) - 1, bits);
+    }
+}
+
+/**
+ * @brief Sets the bits [bit, bit + n) of words to f
+ *
+ * @param words: first word of the bit array
+ * @param bit: index of the first bit to write
+ * @param n: number of bits
+ * @param f: value to write
+ */
+void fillBits(int* words, int bit, int n, bool f) {
+    unsigned int bits = f ? ~0u : 0;
+    int end = bit + n;
+    if ((bit >> 5) == ((end - 1) >> 5)) {
+        if (n > 0) {
+            unsigned int mask = (n == 32 ? ~0u : ((1u << n) - 1)) << (bit & 31);
+            storeMasked(words + (bit >> 5), mask, bits);
+        }
+        return;
+    }
+    if (bit & 31) {
+        storeMasked(words + (bit >> 5), ~0u << (bit & 31), bits);
+        bit = (bit | 31) + 1;
+    }
+    memset(words + (bit >> 5), f ? 0xff : 0, (size_t)((end >> 5) - (bit >> 5)) << 2);
+    if (end & 31) {
+        storeMasked(words + (end >> 5), (1u << (end & 31)) - 1, bits);
+    }
+}
+
+#ifdef SIMD_X86
+// bytes 3k..3k+2 of the input go to bytes 4k+1..4k+3 of the output, byte 4k is zeroed
+#define MEDIUM_SHUFFLE -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11
+// the inverse, bytes 4k..4k+2 go to bytes 3k..3k+2 and the last 4 bytes are zeroed
+#define MEDIUM_PACK_SHUFFLE 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+
+TARGET_SSSE3 static int unpackMediumSSSE3(int* dst, const medium_int* src, int n) {
+    const unsigned char* s = (const unsigned char*)src;
+    const __m128i shuf = _mm_setr_epi8(MEDIUM_SHUFFLE);
+    int i = 0;
+    for (; i + 6 <= n; i += 4) {  // a 16 byte load covers 5 and 1/3 elements
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + i * 3)), shuf);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_srai_epi32(v, 8));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int unpackMediumAVX2(int* dst, const medium_int* src, int n) {
+    const unsigned char* s = (const unsigned char*)src;
+    const __m256i shuf = _mm256_setr_epi8(MEDIUM_SHUFFLE, MEDIUM_SHUFFLE);
+    int i = 0;
+    for (; i + 10 <= n; i += 8) {  // the upper load reads up to element i + 9
+        __m128i lo = _mm_loadu_si128((const __m128i*)(s + i * 3));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(s + i * 3 + 12));
+        __m256i v = _mm256_shuffle_epi8(_mm256_set_m128i(hi, lo), shuf);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_srai_epi32(v, 8));
+    }
+    return i;
+}
+
+// The stores below write a few bytes past the packed vector, those always belong
+// to elements of the range that a later iteration or the scalar tail rewrites.
+TARGET_SSSE3 static int packMediumSSSE3(medium_int* dst, const int* src, int n) {
+    unsigned char* d = (unsigned char*)dst;
+    const __m128i shuf = _mm_setr_epi8(MEDIUM_PACK_SHUFFLE);
+    int i = 0;
+    for (; i + 6 <= n; i += 4) {  // a 16 byte store covers 5 and 1/3 elements
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)), shuf);
+        _mm_storeu_si128((__m128i*)(d + i * 3), v);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int packMediumAVX2(medium_int* dst, const int* src, int n) {
+    unsigned char* d = (unsigned char*)dst;
+    const __m256i shuf = _mm256_setr_epi8(MEDIUM_PACK_SHUFFLE, MEDIUM_PACK_SHUFFLE);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);  // join the two 12 byte halves
+    int i = 0;
+    for (; i + 11 <= n; i += 8) {  // a 32 byte store covers 10 and 2/3 elements
+        __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), shuf);
+        _mm256_storeu_si256((__m256i*)(d + i * 3), _mm256_permutevar8x32_epi32(v, perm));
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief Sign extends n packed medium ints into words
+ *
+ * @param dst: destination words
+ * @param src: medium ints to read
+ * @param n: number of elements
+ */
+void unpackMedium(int* dst, const medium_int* src, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = unpackMediumAVX2(dst, src, n);
+    } else if (hasSSSE3()) {
+        i = unpackMediumSSSE3(dst, src, n);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = loadMedium(src + i);
+    }
+}
+
+/**
+ * @brief Packs the low 3 bytes of n words into medium ints, only the 3n bytes
+ *        at dst are written
+ *
+ * @param dst: destination medium ints
+ * @param src: words to pack
+ * @param n: number of elements
+ */
+void packMedium(medium_int* dst, const int* src, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = packMediumAVX2(dst, src, n);
+    } else if (hasSSSE3()) {
+        i = packMediumSSSE3(dst, src, n);
+    }
+#endif
+    for (; i < n; i++) {
+        storeMedium(dst + i, src[i]);
+    }
+}
+
+/**
+ * @brief Sets n medium ints to the low 3 bytes of val, 8 elements (24 bytes) at a time
+ */
+void fillMedium(medium_int* dst, int val, int n) {
+    unsigned char pattern[24];
+    for (int k = 0; k < 8; k++) {
+        storeMedium(pattern + k * 3, val);
+    }
+    unsigned char* d = (unsigned char*)dst;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        memcpy(d + i * 3, pattern, 24);
+    }
+    for (; i < n; i++) {
+        storeMedium(d + i * 3, val);
+    }
+}
+
+#ifdef SIMD_X86
+TARGET_AVX2 static int fillWordsAVX2(int* dst, int val, int n) {
+    __m256i v = _mm256_set1_epi32(val);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+    return i;
+}
+
+static int fillWordsSSE(int* dst, int val, int n) {
+    __m128i v = _mm_set1_epi32(val);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int iotaWordsAVX2(int* dst, int val, int n, int shift) {
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(val), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i step = _mm256_set1_epi32(8);
+    __m128i cnt = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_sra_epi32(_mm256_sll_epi32(v, cnt), cnt));
+        v = _mm256_add_epi32(v, step);
+    }
+    return i;
+}
+
+static int iotaWordsSSE(int* dst, int val, int n, int shift) {
+    __m128i v = _mm_add_epi32(_mm_set1_epi32(val), _mm_setr_epi32(0, 1, 2, 3));
+    __m128i step = _mm_set1_epi32(4);
+    __m128i cnt = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_sra_epi32(_mm_sll_epi32(v, cnt), cnt));
+        v = _mm_add_epi32(v, step);
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief Sets n words to val
+ */
+void fillWords(int* dst, int val, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    i = hasAVX2() ? fillWordsAVX2(dst, val, n) : fillWordsSSE(dst, val, n);
+#endif
+    for (; i < n; i++) {
+        dst[i] = val;
+    }
+}
+
+/**
+ * @brief Sets dst[i] to val + i, wrapped to 32 - shift bits and sign extended
+ *        (shift is 0 for ints and 8 for 24 bit values)
+ */
+void iotaWords(int* dst, int val, int n, int shift) {
+    int i = 0;
+#ifdef SIMD_X86
+    i = hasAVX2() ? iotaWordsAVX2(dst, val, n, shift) : iotaWordsSSE(dst, val, n, shift);
+#endif
+    for (; i < n; i++) {
+        dst[i] = (int)(((unsigned int)val + i) << shift) >> shift;
+    }
+}
+
+#ifdef SIMD_X86
+TARGET_AVX2 static inline long long hsum64(__m256i v) {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+}
+
+TARGET_AVX2 static int sumWordsAVX2(const int* src, int n, long long& sum) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {  // widened to 64 bit lanes so the sum can't overflow
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    sum += hsum64(acc);
+    return i;
+}
+
+TARGET_AVX2 static int sumCharsAVX2(const char* src, int n, long long& sum) {
+    const __m256i bias = _mm256_set1_epi8(-128);
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {  // c ^ 0x80 is c + 128 unsigned, summed 8 bytes at a time by psadbw
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(src + i)), bias);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(v, _mm256_setzero_si256()));
+    }
+    sum += hsum64(acc) - 128LL * i;
+    return i;
+}
+
+TARGET_AVX2 static int minMaxWordsAVX2(const int* src, int n, int& mn, int& mx) {
+    __m256i lo = _mm256_set1_epi32(mn), hi = _mm256_set1_epi32(mx);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    int l[8], h[8];
+    _mm256_storeu_si256((__m256i*)l, lo);
+    _mm256_storeu_si256((__m256i*)h, hi);
+    for (int k = 0; k < 8; k++) {
+        mn = l[k] < mn ? l[k] : mn;
+        mx = h[k] > mx ? h[k] : mx;
+    }
+    return i;
+}
+
+TARGET_AVX2 static int minMaxCharsAVX2(const char* src, int n, int& mn, int& mx) {
+    __m256i lo = _mm256_set1_epi8(127), hi = _mm256_set1_epi8(-128);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        lo = _mm256_min_epi8(lo, v);
+        hi = _mm256_max_epi8(hi, v);
+    }
+    if (i) {
+        signed char l[32], h[32];
+        _mm256_storeu_si256((__m256i*)l, lo);
+        _mm256_storeu_si256((__m256i*)h, hi);
+        for (int k = 0; k < 32; k++) {
+            mn = l[k] < mn ? l[k] : mn;
+            mx = h[k] > mx ? h[k] : mx;
+        }
+    }
+    return i;
+}
+
+TARGET_AVX2 static int countEqWordsAVX2(const int* src, int n, int val, int& cnt) {
+    __m256i key = _mm256_set1_epi32(val), acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {  // equal lanes are -1
+        acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(src + i)), key));
+    }
+    int c[8];
+    _mm256_storeu_si256((__m256i*)c, acc);
+    for (int k = 0; k < 8; k++) {
+        cnt += c[k];
+    }
+    return i;
+}
+
+TARGET_AVX2 static int countEqCharsAVX2(const char* src, int n, char val, int& cnt) {
+    __m256i key = _mm256_set1_epi8(val), total = _mm256_setzero_si256();
+    int i = 0;
+    while (i + 32 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int r = 0; r < 255 && i + 32 <= n; r++, i += 32) {  // byte counters flushed before they wrap
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), key));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+    }
+    cnt += (int)hsum64(total);
+    return i;
+}
+
+TARGET_AVX2 static int countBitsAVX2(const int* words, int n, long long& cnt) {
+    // popcount of each nibble looked up with pshufb, bytes summed by psadbw
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+        __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, nibble)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+    }
+    cnt += hsum64(acc);
+    return i;
+}
+#endif
+
+/**
+ * @brief Sum of n words
+ */
+long long sumWords(const int* src, int n) {
+    long long sum = 0;
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = sumWordsAVX2(src, n, sum);
+    }
+#endif
+    for (; i < n; i++) {
+        sum += src[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Sum of n chars
+ */
+long long sumChars(const char* src, int n) {
+    long long sum = 0;
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = sumCharsAVX2(src, n, sum);
+    }
+#endif
+    for (; i < n; i++) {
+        sum += src[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Sum of n packed medium ints, unpacked a cache resident chunk at a time
+ */
+long long sumMedium(const medium_int* src, int n) {
+    int buf[MEDIUM_CHUNK];
+    long long sum = 0;
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int k = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(buf, src + i, k);
+        sum += sumWords(buf, k);
+    }
+    return sum;
+}
+
+/**
+ * @brief Lowers mn to the minimum and raises mx to the maximum of n words
+ */
+void minMaxWords(const int* src, int n, int& mn, int& mx) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = minMaxWordsAVX2(src, n, mn, mx);
+    }
+#endif
+    for (; i < n; i++) {
+        mn = src[i] < mn ? src[i] : mn;
+        mx = src[i] > mx ? src[i] : mx;
+    }
+}
+
+/**
+ * @brief Lowers mn to the minimum and raises mx to the maximum of n chars
+ */
+void minMaxChars(const char* src, int n, int& mn, int& mx) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = minMaxCharsAVX2(src, n, mn, mx);
+    }
+#endif
+    for (; i < n; i++) {
+        mn = src[i] < mn ? src[i] : mn;
+        mx = src[i] > mx ? src[i] : mx;
+    }
+}
+
+/**
+ * @brief Lowers mn to the minimum and raises mx to the maximum of n packed medium ints
+ */
+void minMaxMedium(const medium_int* src, int n, int& mn, int& mx) {
+    int buf[MEDIUM_CHUNK];
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int k = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(buf, src + i, k);
+        minMaxWords(buf, k, mn, mx);
+    }
+}
+
+/**
+ * @brief Number of the n words equal to val
+ */
+int countEqWords(const int* src, int n, int val) {
+    int cnt = 0;
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = countEqWordsAVX2(src, n, val, cnt);
+    }
+#endif
+    for (; i < n; i++) {
+        cnt += src[i] == val;
+    }
+    return cnt;
+}
+
+/**
+ * @brief Number of the n chars equal to val
+ */
+int countEqChars(const char* src, int n, char val) {
+    int cnt = 0;
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = countEqCharsAVX2(src, n, val, cnt);
+    }
+#endif
+    for (; i < n; i++) {
+        cnt += src[i] == val;
+    }
+    return cnt;
+}
+
+/**
+ * @brief Number of the n packed medium ints equal to val
+ */
+int countEqMedium(const medium_int* src, int n, int val) {
+    int buf[MEDIUM_CHUNK];
+    int cnt = 0;
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int k = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(buf, src + i, k);
+        cnt += countEqWords(buf, k, val);
+    }
+    return cnt;
+}
+
+/**
+ * @brief Number of set bits in the bits [bit, bit + n) of words, whole words are
+ *        counted 8 at a time
+ *
+ * @param words: first word of the bit array
+ * @param bit: index of the first bit to count
+ * @param n: number of bits
+ */
+int countBits(const int* words, int bit, int n) {
+    if (n <= 0)
+        return 0;
+    const unsigned int* w = (const unsigned int*)words;
+    int end = bit + n;
+    int first = bit >> 5, last = (end - 1) >> 5;
+    unsigned int head = ~0u << (bit & 31);
+    unsigned int tail = (end & 31) ? (1u << (end & 31)) - 1 : ~0u;
+    if (first == last)
+        return __builtin_popcount(w[first] & head & tail);
+    long long cnt = __builtin_popcount(w[first] & head) + __builtin_popcount(w[last] & tail);
+    int i = first + 1;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i += countBitsAVX2(words + i, last - i, cnt);
+    }
+#endif
+    for (; i < last; i++) {
+        cnt += __builtin_popcount(w[i]);
+    }
+    return (int)cnt;
+}
+
+#ifdef SIMD_X86
+TARGET_AVX2 static int addWordsAVX2(int* dst, const int* a, const int* b, int k, int n) {
+    __m256i vk = _mm256_set1_epi32(k);
+    int i = 0;
+    if (k == 1) {
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(x, y));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+            __m256i y = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(b + i)), vk);
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi32(x, y));
+        }
+    }
+    return i;
+}
+
+TARGET_AVX2 static int mulWordsAVX2(int* dst, const int* a, const int* b, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_mullo_epi32(x, y));
+    }
+    return i;
+}
+
+TARGET_AVX2 static int scaleWordsAVX2(int* dst, const int* a, int k, int n) {
+    __m256i vk = _mm256_set1_epi32(k);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_mullo_epi32(x, vk));
+    }
+    return i;
+}
+#endif
+
+// Elementwise arithmetic wraps around like unsigned ints, dst may alias a or b.
+// The medium versions work a chunk at a time: unpack (sign extend), compute on
+// words and pack back the low 3 bytes, which wraps around at 24 bits just like
+// medium_int arithmetic. A chunk is fully read before it is written.
+
+/**
+ * @brief Sets dst[i] to a[i] + k * b[i] for n words
+ */
+void addWords(int* dst, const int* a, const int* b, int k, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = addWordsAVX2(dst, a, b, k, n);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = (int)((unsigned int)a[i] + (unsigned int)k * (unsigned int)b[i]);
+    }
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * b[i] for n words
+ */
+void mulWords(int* dst, const int* a, const int* b, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = mulWordsAVX2(dst, a, b, n);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = (int)((unsigned int)a[i] * (unsigned int)b[i]);
+    }
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * k for n words
+ */
+void scaleWords(int* dst, const int* a, int k, int n) {
+    int i = 0;
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        i = scaleWordsAVX2(dst, a, k, n);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = (int)((unsigned int)a[i] * (unsigned int)k);
+    }
+}
+
+/**
+ * @brief Sets dst[i] to a[i] + k * b[i] for n packed medium ints
+ */
+void addMedium(medium_int* dst, const medium_int* a, const medium_int* b, int k, int n) {
+    int x[MEDIUM_CHUNK], y[MEDIUM_CHUNK];
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int c = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(x, a + i, c);
+        unpackMedium(y, b + i, c);
+        addWords(x, x, y, k, c);
+        packMedium(dst + i, x, c);
+    }
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * b[i] for n packed medium ints
+ */
+void mulMedium(medium_int* dst, const medium_int* a, const medium_int* b, int n) {
+    int x[MEDIUM_CHUNK], y[MEDIUM_CHUNK];
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int c = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(x, a + i, c);
+        unpackMedium(y, b + i, c);
+        mulWords(x, x, y, c);
+        packMedium(dst + i, x, c);
+    }
+}
+
+/**
+ * @brief Sets dst[i] to a[i] * k for n packed medium ints
+ */
+void scaleMedium(medium_int* dst, const medium_int* a, int k, int n) {
+    int x[MEDIUM_CHUNK];
+    for (int i = 0; i < n; i += MEDIUM_CHUNK) {
+        int c = n - i < MEDIUM_CHUNK ? n - i : MEDIUM_CHUNK;
+        unpackMedium(x, a + i, c);
+        scaleWords(x, x, k, c);
+        packMedium(dst + i, x, c);
+    }
+}
+
+static inline unsigned int bitOp(BitOp op, unsigned int a, unsigned int b) {
+    switch (op) {
+        case BIT_AND:
+            return a & b;
+        case BIT_OR:
+            return a | b;
+        case BIT_XOR:
+            return a ^ b;
+        default:
+            return ~a;
+    }
+}
+
+#ifdef SIMD_X86
+template <BitOp op>
+TARGET_AVX2 static int bitOpAVX2(int* dst, const int* a, const int* b, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i r;
+        if (op == BIT_NOT) {
+            r = _mm256_xor_si256(x, _mm256_set1_epi32(-1));
+        } else {
+            __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+            r = op == BIT_AND ? _mm256_and_si256(x, y) : op == BIT_OR ? _mm256_or_si256(x, y) : _mm256_xor_si256(x, y);
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), r);
+    }
+    return i;
+}
+
+TARGET_AVX2 static int skipZeroWordsAVX2(const int* words, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+        if (!_mm256_testz_si256(v, v))
+            break;
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief Sets the bits [bit, bit + n) of dst to a op b (or ~a for BIT_NOT, b is
+ *        then unused), the operands share bit positions so whole words are
+ *        combined 256 bits at a time, dst may alias a or b
+ *
+ * @param dst: first word of the result bit array
+ * @param a: first word of the first operand
+ * @param b: first word of the second operand
+ * @param bit: index of the first bit
+ * @param n: number of bits
+ * @param op: operation
+ */
+void bitOpBits(int* dst, const int* a, const int* b, int bit, int n, BitOp op) {
+    if (n <= 0)
+        return;
+    int end = bit + n;
+    int first = bit >> 5, last = (end - 1) >> 5;
+    unsigned int head = ~0u << (bit & 31);
+    unsigned int tail = (end & 31) ? (1u << (end & 31)) - 1 : ~0u;
+    if (first == last) {
+        storeMasked(dst + first, head & tail, bitOp(op, a[first], b ? b[first] : 0));
+        return;
+    }
+    int i = first;
+    if (head != ~0u) {
+        storeMasked(dst + first, head, bitOp(op, a[first], b ? b[first] : 0));
+        i++;
+    }
+    int full = tail == ~0u ? last + 1 : last;  // words [i, full) are written whole
+#ifdef SIMD_X86
+    if (hasAVX2()) {
+        switch (op) {
+            case BIT_AND:
+                i += bitOpAVX2<BIT_AND>(dst + i, a + i, b + i, full - i);
+                break;
+            case BIT_OR:
+                i += bitOpAVX2<BIT_OR>(dst + i, a + i, b + i, full - i);
+                break;
+            case BIT_XOR:
+                i += bitOpAVX2<BIT_XOR>(dst + i, a + i, b + i, full - i);
+                break;
+            default:
+                i += bitOpAVX2<BIT_NOT>(dst + i, a + i, nullptr, full - i);
+        }
+    }
+#endif
+    for (; i < full; i++) {
+        dst[i] = bitOp(op, a[i], b ? b[i] : 0);
+    }
+    if (full == last) {
+        storeMasked(dst + last, tail, bitOp(op, a[last], b ? b[last] : 0));
+    }
+}
+
+/**
+ * @brief Index of the first set bit in [bit, bit + n) of words, -1 if there is
+ *        none, runs of zero words are skipped 8 at a time
+ *
+ * @param words: first word of the bit array
+ * @param bit: index of the first bit to search
+ * @param n: number of bits
+ * @return int: index of the bit
+ */
+int findBit(const int* words, int bit, int n) {
+    if (n <= 0)
+        return -1;
+    const unsigned int* w = (const unsigned int*)words;
+    int end = bit + n;
+    int i = bit >> 5, last = (end - 1) >> 5;
+    unsigned int x = w[i] & (~0u << (bit & 31));
+    while (i < last) {
+        if (x)
+            return (i << 5) + __builtin_ctz(x);
+        i++;
+#ifdef SIMD_X86
+        if (hasAVX2()) {
+            i += skipZeroWordsAVX2(words + i, last - i);  // stops at last at the latest
+        }
+#endif
+        x = w[i];
+    }
+    if (end & 31) {
+        x &= (1u << (end & 31)) - 1;
+    }
+    return x ? (i << 5) + __builtin_ctz(x) : -1;
+}
+
+/**
+ * @brief The k <= 32 bits of w starting at bit pos, in the low bits
+ */
+static inline unsigned int bitsAt(const unsigned int* w, int pos, int k) {
+    int i = pos >> 5, o = pos & 31;
+    unsigned int x = w[i] >> o;
+    if (o + k > 32)
+        x |= w[i + 1] << (32 - o);
+    return x;
+}
+
+/**
+ * @brief Copies the bits of dst word w that lie in [dbit, dbit + n) from src
+ */
+static inline void copyBitsWord(unsigned int* dst, int dbit, const unsigned int* src, int sbit, int n, int w) {
+    int lo = dbit > (w << 5) ? dbit : w << 5;
+    int hi = dbit + n < ((w + 1) << 5) ? dbit + n : (w + 1) << 5;
+    unsigned int bits = bitsAt(src, sbit + (lo - dbit), hi - lo) << (lo & 31);
+    if (hi - lo == 32)
+        dst[w] = bits;
+    else
+        storeMasked((int*)dst + w, (((1u << (hi - lo)) - 1)) << (lo & 31), bits);
+}
+
+/**
+ * @brief Copies n bits from [sbit, sbit + n) of src to [dbit, dbit + n) of dst, the
+ *        ranges may overlap when dst is src. Ranges starting at the same bit of a
+ *        word are copied with memmove, others a shifted word at a time.
+ *
+ * @param dst: first word of the destination bit array
+ * @param dbit: index of the first bit to write
+ * @param src: first word of the source bit array
+ * @param sbit: index of the first bit to read
+ * @param n: number of bits
+ */
+void copyBits(int* dst, int dbit, const int* src, int sbit, int n) {
+    if (n <= 0)
+        return;
+    unsigned int* d = (unsigned int*)dst;
+    const unsigned int* s = (const unsigned int*)src;
+    int end = dbit + n;
+    int first = dbit >> 5, last = (end - 1) >> 5;
+    if (((dbit ^ sbit) & 31) == 0) {
+        int delta = (sbit >> 5) - first;
+        unsigned int head = ~0u << (dbit & 31);
+        unsigned int tail = (end & 31) ? (1u << (end & 31)) - 1 : ~0u;
+        if (first == last) {
+            storeMasked(dst + first, head & tail, s[first + delta]);
+            return;
+        }
+        // the edge words are read before and written after the middle moves
+        unsigned int hv = s[first + delta], tv = s[last + delta];
+        int lo = head == ~0u ? first : first + 1;
+        int hi = tail == ~0u ? last + 1 : last;
+        memmove(d + lo, s + lo + delta, (size_t)(hi - lo) << 2);
+        if (head != ~0u)
+            storeMasked(dst + first, head, hv);
+        if (tail != ~0u)
+            storeMasked(dst + last, tail, tv);
+        return;
+    }
+    if (dst == src && dbit > sbit) {
+        // moving up, every word reads source bits below the words written before it
+        for (int w = last; w >= first; w--) {
+            copyBitsWord(d, dbit, s, sbit, n, w);
+        }
+    } else {
+        for (int w = first; w <= last; w++) {
+            copyBitsWord(d, dbit, s, sbit, n, w);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef _SIMD_H
+#define _SIMD_H
+
+#include <cstring>
+
+#include "medium_int.h"
+
+// Kernels working directly on the packed word layout of the heap.
+// x86-64 builds use AVX2 when the cpu supports it (checked at runtime) and
+// SSE otherwise, build with -DNO_SIMD to force the scalar versions.
+// Partial words at the edges of a bit range are updated atomically since
+// other bits of the word may be written concurrently by accessors.
+// Medium ints are packed 3 bytes to an element across word boundaries and are
+// written bytewise, so neighbouring elements are never touched.
+
+static_assert(sizeof(medium_int) == 3, "medium ints are packed 3 bytes to an element");
+
+/**
+ * @brief Loads the (possibly unaligned) 3 byte medium int at p, sign extended
+ */
+inline int loadMedium(const void* p) {
+    int val = 0;
+    memcpy((char*)&val + 1, p, 3);
+    return val >> 8;
+}
+
+/**
+ * @brief Stores the low 3 bytes of val at p
+ */
+inline void storeMedium(void* p, int val) {
+    memcpy(p, &val, 3);
+}
+
+void packBits(int* words, int bit, const bool* src, int n);
+void fillBits(int* words, int bit, int n, bool f);
+void unpackMedium(int* dst, const medium_int* src, int n);
+void packMedium(medium_int* dst, const int* src, int n);
+void fillMedium(medium_int* dst, int val, int n);
+void fillWords(int* dst, int val, int n);
+void iotaWords(int* dst, int val, int n, int shift);
+
+// Reductions, medium ints are compared and summed sign extended
+long long sumWords(const int* src, int n);
+long long sumChars(const char* src, int n);
+long long sumMedium(const medium_int* src, int n);
+void minMaxWords(const int* src, int n, int& mn, int& mx);
+void minMaxChars(const char* src, int n, int& mn, int& mx);
+void minMaxMedium(const medium_int* src, int n, int& mn, int& mx);
+int countEqWords(const int* src, int n, int val);
+int countEqChars(const char* src, int n, char val);
+int countEqMedium(const medium_int* src, int n, int val);
+int countBits(const int* words, int bit, int n);
+
+// Elementwise arithmetic, wraps around at 32 bits for words and 24 bits for medium ints
+void addWords(int* dst, const int* a, const int* b, int k, int n);
+void mulWords(int* dst, const int* a, const int* b, int n);
+void scaleWords(int* dst, const int* a, int k, int n);
+void addMedium(medium_int* dst, const medium_int* a, const medium_int* b, int k, int n);
+void mulMedium(medium_int* dst, const medium_int* a, const medium_int* b, int n);
+void scaleMedium(medium_int* dst, const medium_int* a, int k, int n);
+
+// Bitwise operations on bit arrays
+enum BitOp { BIT_AND, BIT_OR, BIT_XOR, BIT_NOT };
+void bitOpBits(int* dst, const int* a, const int* b, int bit, int n, BitOp op);
+int findBit(const int* words, int bit, int n);
+void copyBits(int* dst, int dbit, const int* src, int sbit, int n);
+
+#endif  // _SIMD_H